@@ -0,0 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "../test/allocation_counter.h"
+
+// Wall time and heap allocations of a repeated block of work.
+struct Measurement {
+    double ms_per_iteration = 0.;
+    double allocations_per_iteration = 0.;
+};
+
+template <typename F>
+Measurement Measure(int iterations, F &&f)
+{
+    const auto allocations = g_Allocations.load();
+    const auto start = std::chrono::steady_clock::now();
+    for( int i = 0; i < iterations; ++i )
+        f();
+    const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return {elapsed / iterations, double(g_Allocations.load() - allocations) / iterations};
+}
+
+inline void Report(const std::string &name, const Measurement &m)
+{
+    std::printf("%-40s %10.3f ms %14.1f allocs\n", name.c_str(), m.ms_per_iteration, m.allocations_per_iteration);
+}
+
+// Distribution of the latencies of single operations, in microseconds.
+struct Latency {
+    std::size_t count = 0;
+    double p50 = 0.;
+    double p95 = 0.;
+    double p99 = 0.;
+    double max = 0.;
+};
+
+// Nearest-rank percentiles of the samples.
+inline Latency Summarize(std::vector<double> samples)
+{
+    Latency latency;
+    latency.count = samples.size();
+    if( samples.empty() )
+        return latency;
+    std::sort(samples.begin(), samples.end());
+    // The smallest sample at least a fraction p of all samples are no greater than: rank ceil(p * n),
+    // counting from 1. The tolerance keeps products like 0.29 * 100 from rounding up a rank.
+    auto rank = [&](double p) {
+        const auto nearest = static_cast<std::size_t>(std::ceil(p * samples.size() - 1e-9));
+        return samples[std::min(samples.size(), std::max<std::size_t>(nearest, 1)) - 1];
+    };
+    latency.p50 = rank(.50);
+    latency.p95 = rank(.95);
+    latency.p99 = rank(.99);
+    latency.max = samples.back();
+    return latency;
+}
+
+// Microseconds f() takes.
+template <typename F>
+double TimeMicroseconds(F &&f)
+{
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Largest resident set of the process so far.
+inline long PeakRssKilobytes()
+{
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// Resident set of the process now, 0 where /proc is not available.
+inline long CurrentRssKilobytes()
+{
+    long pages = 0, resident = 0;
+    if( FILE *statm = std::fopen("/proc/self/statm", "r") ) {
+        if( std::fscanf(statm, "%ld %ld", &pages, &resident) != 2 )
+            resident = 0;
+        std::fclose(statm);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
@@ -0,0 +1,711 @@
+#include "bench_util.h"
+#include "../src/contraction_hierarchy.h"
+#include "../src/distance_kernel.h"
+#include "../src/landmark_table.h"
+#include "../src/matrix_engine.h"
+#include "../src/model.h"
+#include "../src/open_list.h"
+#include "../src/osm_id_index.h"
+#include "../src/route_engine.h"
+#include "../src/route_model.h"
+#include "../src/route_server.h"
+#include "../src/routing_profile.h"
+#include "../src/search_workspace.h"
+#include "../src/xml_stream.h"
+#include "../test/test_data.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <random>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Node ids and the node references of ways, as they appear in the file.
+class IdCollector : public XmlStreamParser::Handler
+{
+public:
+    std::vector<std::string> node_ids;
+    std::vector<std::string> node_refs;
+    
+    void StartElement(std::string_view name, const std::vector<XmlStreamParser::Attribute> &attributes) override
+    {
+        if( name == "node" )
+            node_ids.emplace_back(XmlStreamParser::Find(attributes, "id"));
+        else if( name == "nd" )
+            node_refs.emplace_back(XmlStreamParser::Find(attributes, "ref"));
+    }
+    void EndElement(std::string_view) override {}
+};
+
+// Id resolution as done by the loader: every node id is interned, then every way's node
+// references are looked up. Compares string keyed hashing with the integer id index.
+static void BenchIdResolution(const std::vector<std::byte> &xml, int iterations)
+{
+    IdCollector ids;
+    XmlStreamParser parser{ids};
+    parser.Feed((const char*)xml.data(), xml.size());
+    parser.Finish();
+    std::printf("%zu node ids, %zu node references\n", ids.node_ids.size(), ids.node_refs.size());
+    
+    long found = 0;
+    Report("ids: unordered_map<string, int>", Measure(iterations, [&]{
+        std::unordered_map<std::string, int> index;
+        for( std::size_t i = 0; i < ids.node_ids.size(); ++i )
+            index[ids.node_ids[i]] = (int)i;
+        for( auto &ref: ids.node_refs )
+            found += index.find(std::string{ref.c_str()}) != index.end();
+    }));
+    
+    auto intern = [&](const std::vector<std::string> &node_ids) {
+        OsmIdIndex index;
+        for( std::size_t i = 0; i < node_ids.size(); ++i )
+            if( std::int64_t id; OsmIdIndex::Parse(node_ids[i], id) )
+                index.Insert(id, (int)i);
+        for( auto &ref: ids.node_refs )
+            if( std::int64_t id; OsmIdIndex::Parse(ref, id) )
+                found += index.Find(id) >= 0;
+    };
+    Report("ids: OsmIdIndex, sorted input", Measure(iterations, [&]{ intern(ids.node_ids); }));
+    
+    auto shuffled = ids.node_ids;
+    std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937{42});
+    Report("ids: OsmIdIndex, shuffled input", Measure(iterations, [&]{ intern(shuffled); }));
+    
+    if( found == 0 )
+        std::printf("no references resolved\n");
+}
+
+static void BenchLoad(const std::string &osm_file, const std::vector<std::byte> &xml, int iterations)
+{
+    Report("load: Model(xml), pugixml DOM", Measure(iterations, [&]{ Model{xml}; }));
+    Report("load: Model(file), streaming", Measure(iterations, [&]{ Model{osm_file}; }));
+    ModelOptions series;
+    series.projection_tolerance = 1e-3;
+    Report("load: Model(file), 1 mm projection", Measure(iterations, [&]{ Model{osm_file, series}; }));
+    for( unsigned threads: {2u, 4u, 8u} ) {
+        ModelOptions options;
+        options.threads = threads;
+        Report("load: Model(file), " + std::to_string(threads) + " threads", Measure(iterations, [&]{ Model{osm_file, options}; }));
+    }
+}
+
+// RandomQueries between nodes on non-footway roads, as engine queries.
+static std::vector<RouteEngine::Query> RoadQueries(const RouteModel &model, int count, unsigned seed)
+{
+    std::vector<RouteEngine::Query> queries;
+    for( auto [start, goal]: RandomQueries(model, count, seed, true) )
+        queries.push_back({start, goal});
+    return queries;
+}
+
+// The open list RoutePlanner used before it had decrease-key: a node is pushed once when it is
+// first reached, keeps that first g value and nothing is ever closed. Kept as a baseline.
+class LazyAStar
+{
+public:
+    LazyAStar(const RouteModel &model) : m_Model(model) {}
+    
+    RoutePlanner::Result Route(int start, int goal)
+    {
+        const auto &nodes = m_Model.SNodes();
+        const auto &graph = m_Model.RoadGraph();
+        RoutePlanner::Result result;
+        m_Workspace.Reset(nodes.size());
+        m_Open = {};
+        m_Workspace.Visit(start, -1, 0.f, nodes[start].distance(nodes[goal]));
+        m_Open.push({m_Workspace.H(start), start});
+        result.stats.pushed++;
+        while( !m_Open.empty() ) {
+            const int current = m_Open.top().second;
+            m_Open.pop();
+            result.stats.expanded++;
+            if( current == goal ) {
+                for( int node = goal; m_Workspace.Parent(node) != -1; node = m_Workspace.Parent(node) )
+                    result.distance += nodes[node].distance(nodes[m_Workspace.Parent(node)]);
+                result.distance *= m_Model.MetricScale();
+                break;
+            }
+            for( int edge = graph.offsets[current]; edge < graph.offsets[current + 1]; ++edge ) {
+                const int node = graph.targets[edge];
+                if( !DistanceProfile::Allows(graph.types[edge]) || m_Workspace.Visited(node) )
+                    continue;
+                const float g = m_Workspace.G(current) + graph.lengths[edge];
+                const float h = nodes[node].distance(nodes[goal]);
+                m_Workspace.Visit(node, current, g, h);
+                m_Open.push({g + h, node});
+                result.stats.pushed++;
+            }
+        }
+        return result;
+    }
+    
+private:
+    using Entry = std::pair<float, int>;
+    const RouteModel &m_Model;
+    SearchWorkspace m_Workspace;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> m_Open;
+};
+
+// Runs route(query) for every query once per iteration and prints the mean search counters of
+// one query.
+template <typename RouteQuery>
+static void BenchPlanner(const std::string &name, RouteQuery &&route, const std::vector<RouteEngine::Query> &queries, int iterations)
+{
+    double expanded = 0, pushed = 0, decreased = 0, distance = 0, seconds = 0;
+    auto m = Measure(iterations, [&]{
+        for( auto &query: queries ) {
+            auto result = route(query);
+            expanded += result.stats.expanded;
+            pushed += result.stats.pushed;
+            decreased += result.stats.decreased;
+            distance += result.distance;
+            seconds += result.seconds;
+        }
+    });
+    const auto runs = double(iterations) * queries.size();
+    Report(name, m);
+    std::printf("    per query: %.1f expanded, %.1f pushed, %.1f decreased, %.2f m, %.1f s\n",
+                expanded / runs, pushed / runs, decreased / runs, distance / runs, seconds / runs);
+}
+
+static void BenchRoutes(const std::string &osm_file, int iterations)
+{
+    const RouteModel model{osm_file};
+    const auto queries = RoadQueries(model, 1000, 1);
+    
+    LazyAStar lazy{model};
+    BenchPlanner("route: lazy open list, 1000 queries", [&](auto &q){ return lazy.Route(q.start, q.goal); }, queries, iterations);
+    RoutePlanner planner{model};
+    auto forward = [&](auto &q){ return planner.Route(q.start, q.goal); };
+    auto bidirectional = [&](auto &q){ return planner.Route(q.start, q.goal, RoutePlanner::Search::Bidirectional); };
+    BenchPlanner("route: RoutePlanner, 1000 queries", forward, queries, iterations);
+    BenchPlanner("route: bidirectional, 1000 queries", bidirectional, queries, iterations);
+    for( auto [name, profile]: {std::pair{"car", Profile::Car}, std::pair{"bike", Profile::Bike}, std::pair{"foot", Profile::Foot}} ) {
+        auto route = [&](auto &q){ return planner.Route(q.start, q.goal, RoutePlanner::Search::Forward, profile); };
+        BenchPlanner(std::string{"route: "} + name + " profile, 1000 queries", route, queries, iterations);
+    }
+    
+    // Cross-map routes, between nodes at least half the map's extent apart.
+    std::vector<RouteEngine::Query> long_queries;
+    for( auto &query: RoadQueries(model, 20000, 2) ) {
+        auto &nodes = model.SNodes();
+        if( nodes[query.start].distance(nodes[query.goal]) > 0.5f && long_queries.size() < 1000 )
+            long_queries.push_back(query);
+    }
+    const auto long_count = std::to_string(long_queries.size());
+    BenchPlanner("route: RoutePlanner, " + long_count + " long", forward, long_queries, iterations);
+    BenchPlanner("route: bidirectional, " + long_count + " long", bidirectional, long_queries, iterations);
+    
+    RouteModel landmark_model{osm_file};
+    for( int count: {4, 8, 16} ) {
+        Report("route: landmark tables, " + std::to_string(count) + " landmarks", Measure(1, [&]{ landmark_model.BuildLandmarks(count); }));
+        RoutePlanner landmark_planner{landmark_model};
+        auto landmarks = [&](auto &q){ return landmark_planner.Route(q.start, q.goal, RoutePlanner::Search::Landmarks); };
+        BenchPlanner("route: ALT " + std::to_string(count) + ", 1000 queries", landmarks, queries, iterations);
+        BenchPlanner("route: ALT " + std::to_string(count) + ", " + long_count + " long", landmarks, long_queries, iterations);
+    }
+    
+    RouteModel hierarchy_model{osm_file};
+    Report("route: contraction hierarchy build", Measure(1, [&]{ hierarchy_model.BuildHierarchy(); }));
+    std::printf("    %zu shortcuts over %zu road segments\n", hierarchy_model.Hierarchy()->Shortcuts(),
+                hierarchy_model.RoadGraph().targets.size() / 2);
+    RoutePlanner hierarchy_planner{hierarchy_model};
+    auto hierarchy = [&](auto &q){ return hierarchy_planner.Route(q.start, q.goal, RoutePlanner::Search::Hierarchy); };
+    BenchPlanner("route: hierarchy, 1000 queries", hierarchy, queries, iterations);
+    BenchPlanner("route: hierarchy, " + long_count + " long", hierarchy, long_queries, iterations);
+    
+    for( unsigned threads: {1u, 2u, 4u, 8u} ) {
+        RouteEngine engine{model, threads};
+        Report("route: RouteEngine, " + std::to_string(threads) + " threads", Measure(iterations, [&]{ engine.Route(queries); }));
+    }
+}
+
+// RouteModel::Node as it was before the search state and adjacency moved out of it: double
+// coordinates, search fields and a neighbor vector per node, 80 bytes on 64-bit targets.
+struct LegacyNode {
+    double x = 0., y = 0.;
+    LegacyNode *parent = nullptr;
+    float h_value = std::numeric_limits<float>::max();
+    float g_value = 0.f;
+    bool visited = false;
+    std::vector<LegacyNode *> neighbors;
+    int index = -1;
+    const RouteModel *parent_model = nullptr;
+    
+    float distance(const LegacyNode &other) const { return std::sqrt(std::pow(x - other.x, 2) + std::pow(y - other.y, 2)); }
+};
+
+// The same A* as RoutePlanner with decrease-key, run on LegacyNode, so the two only differ in
+// memory layout. Segment lengths are recomputed from the coordinates like the old search did.
+class LegacyLayoutAStar
+{
+public:
+    LegacyLayoutAStar(const RouteModel &model) : m_Nodes(model.SNodes().size())
+    {
+        const auto &graph = model.RoadGraph();
+        for( int i = 0; i < (int)m_Nodes.size(); ++i ) {
+            auto &node = m_Nodes[i];
+            node.x = model.SNodes()[i].x;
+            node.y = model.SNodes()[i].y;
+            node.index = i;
+            node.parent_model = &model;
+            for( int edge = graph.offsets[i]; edge < graph.offsets[i + 1]; ++edge )
+                if( DistanceProfile::Allows(graph.types[edge]) && (node.neighbors.empty() || node.neighbors.back() != &m_Nodes[graph.targets[edge]]) )
+                    node.neighbors.push_back(&m_Nodes[graph.targets[edge]]);
+        }
+    }
+    
+    RoutePlanner::Result Route(int start, int goal)
+    {
+        for( LegacyNode *node: m_Touched )
+            *node = Reset(*node);
+        m_Touched.clear();
+        m_Open.Reset(m_Nodes.size());
+        RoutePlanner::Result result;
+        LegacyNode &goal_node = m_Nodes[goal];
+        Visit(m_Nodes[start], nullptr, 0.f, m_Nodes[start].distance(goal_node));
+        m_Open.Push(start, m_Nodes[start].h_value);
+        result.stats.pushed++;
+        while( !m_Open.Empty() ) {
+            LegacyNode &current = m_Nodes[m_Open.Pop()];
+            result.stats.expanded++;
+            if( &current == &goal_node ) {
+                for( LegacyNode *node = &current; node->parent; node = node->parent )
+                    result.distance += node->distance(*node->parent);
+                result.distance *= current.parent_model->MetricScale();
+                break;
+            }
+            for( LegacyNode *neighbor: current.neighbors ) {
+                const bool closed = neighbor->visited && !m_Open.Contains(neighbor->index);
+                if( closed )
+                    continue;
+                const float g = current.g_value + current.distance(*neighbor);
+                if( !neighbor->visited ) {
+                    Visit(*neighbor, &current, g, neighbor->distance(goal_node));
+                    m_Open.Push(neighbor->index, g + neighbor->h_value);
+                    result.stats.pushed++;
+                }
+                else if( g < neighbor->g_value ) {
+                    Visit(*neighbor, &current, g, neighbor->h_value);
+                    m_Open.DecreaseKey(neighbor->index, g + neighbor->h_value);
+                    result.stats.decreased++;
+                }
+            }
+        }
+        return result;
+    }
+    
+private:
+    static LegacyNode Reset(LegacyNode &node)
+    {
+        node.parent = nullptr;
+        node.h_value = std::numeric_limits<float>::max();
+        node.g_value = 0.f;
+        node.visited = false;
+        return std::move(node);
+    }
+    
+    void Visit(LegacyNode &node, LegacyNode *parent, float g, float h)
+    {
+        if( !node.visited )
+            m_Touched.push_back(&node);
+        node.parent = parent;
+        node.g_value = g;
+        node.h_value = h;
+        node.visited = true;
+    }
+    
+    std::vector<LegacyNode> m_Nodes;
+    std::vector<LegacyNode *> m_Touched;
+    OpenList m_Open;
+};
+
+// Node storage of RoutePlanner against the old per-node struct. The sweeps read the straight-line
+// distance of every node to one goal, in order and in random order, over the map's nodes tiled
+// to a million so they no longer fit in cache: they are bound by the bytes per node and the cache
+// misses per node. The A* queries then run on both layouts of the map itself, and snapping and
+// A* run on the model with nodes in file order and in Hilbert order.
+static void BenchLayout(const std::string &osm_file, int iterations)
+{
+    const RouteModel model{osm_file};
+    const auto &graph = model.RoadGraph();
+    const int map_count = (int)graph.xs.size();
+    const int copies = std::max(1, (1 << 20) / std::max(1, map_count));
+    const int count = map_count * copies;
+    std::vector<LegacyNode> legacy_nodes(count);
+    std::vector<float> xs(count), ys(count);
+    for( int i = 0; i < count; ++i ) {
+        legacy_nodes[i].x = xs[i] = graph.xs[i % map_count];
+        legacy_nodes[i].y = ys[i] = graph.ys[i % map_count];
+        legacy_nodes[i].index = i;
+    }
+    std::vector<int> shuffled(count);
+    for( int i = 0; i < count; ++i )
+        shuffled[i] = i;
+    std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937{9});
+    std::printf("    %d nodes, %zu bytes per legacy node, %zu bytes of coordinates per node\n",
+                count, sizeof(LegacyNode), 2 * sizeof(float));
+    
+    double sum = 0.;
+    auto sweep = [&](const std::string &name, auto &&node_at) {
+        auto m = Measure(iterations, [&]{
+            float total = 0.f;
+            for( int i = 0; i < count; ++i )
+                total += node_at(i);
+            sum += total;
+        });
+        Report(name, m);
+        std::printf("    %.2f ns per node\n", m.ms_per_iteration * 1e6 / count);
+    };
+    const LegacyNode goal = legacy_nodes[count / 2];
+    auto float_distance = [&](int node) {
+        const float dx = xs[node] - xs[count / 2], dy = ys[node] - ys[count / 2];
+        return std::sqrt(dx * dx + dy * dy);
+    };
+    sweep("layout: sweep, legacy nodes", [&](int i){ return legacy_nodes[i].distance(goal); });
+    sweep("layout: sweep, float arrays", float_distance);
+    sweep("layout: random order, legacy nodes", [&](int i){ return legacy_nodes[shuffled[i]].distance(goal); });
+    sweep("layout: random order, float arrays", [&](int i){ return float_distance(shuffled[i]); });
+    
+    const auto queries = RoadQueries(model, 1000, 1);
+    LegacyLayoutAStar legacy{model};
+    BenchPlanner("layout: A*, legacy nodes, 1000 queries", [&](auto &q){ return legacy.Route(q.start, q.goal); }, queries, iterations);
+    RoutePlanner planner{model};
+    BenchPlanner("layout: A*, RoutePlanner, 1000 queries", [&](auto &q){ return planner.Route(q.start, q.goal); }, queries, iterations);
+    
+    // The same points in both orders, so both models answer the same queries.
+    std::mt19937 rng{6};
+    std::uniform_real_distribution<float> coordinate{0.f, 1.f};
+    std::vector<std::pair<float, float>> points(2000);
+    for( auto &point: points )
+        point = {coordinate(rng), coordinate(rng)};
+    for( bool reorder: {false, true} ) {
+        ModelOptions options;
+        options.reorder_nodes = reorder;
+        const RouteModel ordered_model{osm_file, options};
+        const std::string order = reorder ? "Hilbert order" : "file order";
+        std::vector<RouteEngine::Query> point_queries(points.size() / 2);
+        Report("layout: FindClosestNode, " + order, Measure(iterations, [&]{
+            for( std::size_t i = 0; i < point_queries.size(); ++i )
+                point_queries[i] = {ordered_model.FindClosestNode(points[2 * i].first, points[2 * i].second).Index(),
+                                    ordered_model.FindClosestNode(points[2 * i + 1].first, points[2 * i + 1].second).Index()};
+        }));
+        RoutePlanner ordered_planner{ordered_model};
+        BenchPlanner("layout: A*, " + order, [&](auto &q){ return ordered_planner.Route(q.start, q.goal); }, point_queries, iterations);
+    }
+    if( sum == 0. )
+        std::printf("empty map\n");
+}
+
+// The distance kernels at every SIMD level the host supports, over a million points: the
+// closest-point screen of nearest-node search, the neighbor heuristics of A* and path lengths.
+static void BenchDistanceKernels(int iterations)
+{
+    constexpr int count = 1 << 20;
+    std::mt19937 rng{8};
+    std::uniform_real_distribution<double> coordinate{0., 1.};
+    std::uniform_int_distribution<int> pick{0, count - 1};
+    std::vector<double> xs(count), ys(count);
+    std::vector<float> float_xs(count), float_ys(count), out(count);
+    std::vector<Model::Node> nodes(count);
+    std::vector<int> ids(count);
+    for( int i = 0; i < count; ++i ) {
+        nodes[i] = {xs[i] = float_xs[i] = coordinate(rng), ys[i] = float_ys[i] = coordinate(rng)};
+        ids[i] = pick(rng);
+    }
+    
+    static const char *names[] = {"scalar", "SSE2", "AVX2"};
+    double sink = 0.;
+    for( auto level: {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2} ) {
+        const auto &kernels = GetDistanceKernels(level);
+        if( kernels.level != level )
+            continue;
+        const std::string name = names[(int)level];
+        Report("simd: min distance, " + name, Measure(iterations, [&]{ sink += kernels.min_squared_distance(xs.data(), ys.data(), count, .5, .5); }));
+        Report("simd: gathered distances, " + name, Measure(iterations, [&]{
+            kernels.gather_distances(float_xs.data(), float_ys.data(), ids.data(), count, .5f, .5f, out.data());
+            sink += out[count / 2];
+        }));
+        Report("simd: path length, " + name, Measure(iterations, [&]{ sink += kernels.path_length(nodes.data(), ids.data(), count); }));
+    }
+    std::printf("    host level: %s\n", names[(int)HostSimdLevel()]);
+    if( sink == 0. )
+        std::printf("no distances\n");
+}
+
+// N x N distance tables from pairwise RoutePlanner queries and from MatrixEngine.
+static void BenchMatrix(const std::string &osm_file, int iterations)
+{
+    RouteModel model{osm_file};
+    std::vector<int> nodes;
+    for( auto &query: RoadQueries(model, 1000, 4) )
+        nodes.push_back(query.start);
+    const std::vector<int> hundred(nodes.begin(), nodes.begin() + 100);
+    
+    RoutePlanner planner{model};
+    Report("matrix: RoutePlanner pairs, 100x100", Measure(iterations, [&]{
+        for( int source: hundred )
+            for( int target: hundred )
+                planner.Route(source, target);
+    }));
+    MatrixEngine engine{model};
+    model.BuildHierarchy();
+    for( auto [name, method]: {std::pair{"Dijkstra", MatrixEngine::Method::Dijkstra}, std::pair{"hierarchy", MatrixEngine::Method::Hierarchy}} ) {
+        Report(std::string{"matrix: "} + name + ", 100x100", Measure(iterations, [&]{ engine.Compute(hundred, hundred, method); }));
+        Report(std::string{"matrix: "} + name + ", 1000x1000", Measure(iterations, [&]{ engine.Compute(nodes, nodes, method); }));
+    }
+}
+
+// Snapping random points to the road network with a scan over every road node, as
+// FindClosestNode did before the grid index, and with the index.
+static void BenchSnap(const std::string &osm_file, int iterations)
+{
+    const RouteModel model{osm_file};
+    std::mt19937 rng{3};
+    std::uniform_real_distribution<float> coordinate{0.f, 1.f};
+    std::vector<std::pair<float, float>> points(1000);
+    for( auto &point: points )
+        point = {coordinate(rng), coordinate(rng)};
+    
+    long checksum = 0;
+    Report("snap: road node scan, 1000 points", Measure(iterations, [&]{
+        for( auto [x, y]: points ) {
+            float min_dist = std::numeric_limits<float>::max();
+            int closest = -1;
+            for( const Model::Road &road: model.Roads() ) {
+                if( road.type == Model::Road::Type::Footway )
+                    continue;
+                for( int node: model.Ways()[road.way].nodes ) {
+                    const float dist = std::hypot(model.Nodes()[node].x - x, model.Nodes()[node].y - y);
+                    if( dist < min_dist ) {
+                        min_dist = dist;
+                        closest = node;
+                    }
+                }
+            }
+            checksum += closest;
+        }
+    }));
+    Report("snap: FindClosestNode, 1000 points", Measure(iterations, [&]{
+        for( auto [x, y]: points )
+            checksum -= model.FindClosestNode(x, y).Index();
+    }));
+    Report("snap: KNearest(8), 1000 points", Measure(iterations, [&]{
+        for( auto [x, y]: points )
+            checksum += model.RoadNodeIndex().KNearest(x, y, 8).size();
+    }));
+    if( checksum != long(iterations) * 8 * (long)points.size() )
+        std::printf("snap: the index and the scan disagree\n");
+}
+
+// Per-operation latency percentiles of one stage of the latency suite, with the mean search
+// counters where the operation is a search and how much the resident set grew while it ran.
+struct LatencyRecord {
+    std::string name;
+    Latency latency;
+    double expanded = -1.;        // Means per query, negative for stages that do not search.
+    double heap_operations = -1.; // Pushes, decrease-keys and pops.
+    long rss_growth_kb = 0;       // Resident set after the stage less before it, setup included.
+    long peak_rss_kb = -1;        // Peak resident set of the process, for the load stage only.
+};
+
+static void PrintLatency(const LatencyRecord &record)
+{
+    const auto &l = record.latency;
+    std::printf("%-40s p50 %9.2f  p95 %9.2f  p99 %9.2f  max %9.2f us %+9ld KB resident",
+                record.name.c_str(), l.p50, l.p95, l.p99, l.max, record.rss_growth_kb);
+    if( record.peak_rss_kb >= 0 )
+        std::printf(", %ld KB peak", record.peak_rss_kb);
+    std::printf("\n");
+    if( record.expanded >= 0 )
+        std::printf("    per query: %.1f expanded, %.1f heap operations\n", record.expanded, record.heap_operations);
+}
+
+static std::string JsonString(const std::string &s)
+{
+    std::string quoted = "\"";
+    for( char c: s ) {
+        if( c == '"' || c == '\\' )
+            quoted += '\\';
+        quoted += c;
+    }
+    return quoted + '"';
+}
+
+static bool WriteLatencyJson(const std::string &path, const std::string &osm_file, unsigned seed, int iterations,
+                             const std::vector<LatencyRecord> &records)
+{
+    std::ofstream os{path};
+    os << "{\n  \"map\": " << JsonString(osm_file) << ",\n  \"seed\": " << seed << ",\n  \"iterations\": " << iterations
+       << ",\n  \"results\": [";
+    for( std::size_t i = 0; i < records.size(); ++i ) {
+        const auto &r = records[i];
+        os << (i ? ",\n" : "\n") << "    {\"name\": " << JsonString(r.name) << ", \"count\": " << r.latency.count
+           << ", \"p50_us\": " << r.latency.p50 << ", \"p95_us\": " << r.latency.p95 << ", \"p99_us\": " << r.latency.p99
+           << ", \"max_us\": " << r.latency.max;
+        if( r.expanded >= 0 )
+            os << ", \"expanded\": " << r.expanded << ", \"heap_operations\": " << r.heap_operations;
+        os << ", \"rss_growth_kb\": " << r.rss_growth_kb;
+        if( r.peak_rss_kb >= 0 )
+            os << ", \"peak_rss_kb\": " << r.peak_rss_kb;
+        os << "}";
+    }
+    os << "\n  ]\n}\n";
+    return bool(os);
+}
+
+// Latency distributions of what a routing request does: loading the model, snapping points to
+// roads and searching, over seeded random points and queries so runs compare across builds.
+// Optionally written to a JSON file for regression tracking.
+static void BenchLatency(const std::string &osm_file, int iterations, unsigned seed, const std::string &json_path)
+{
+    std::vector<LatencyRecord> records;
+    // The peak resident set is that of the whole process, so it is only told for the load, which
+    // runs first; later stages report what they added to the resident set.
+    auto stage_rss = CurrentRssKilobytes();
+    auto record = [&](LatencyRecord r) {
+        const auto rss = CurrentRssKilobytes();
+        r.rss_growth_kb = rss - stage_rss;
+        stage_rss = rss;
+        PrintLatency(r);
+        records.push_back(std::move(r));
+    };
+    
+    std::vector<double> samples;
+    for( int i = 0; i < iterations; ++i )
+        samples.push_back(TimeMicroseconds([&]{ RouteModel{osm_file}; }));
+    LatencyRecord load{"latency: RouteModel load", Summarize(samples)};
+    load.peak_rss_kb = PeakRssKilobytes();
+    record(std::move(load));
+    
+    RouteModel model{osm_file};
+    std::mt19937 rng{seed};
+    std::uniform_real_distribution<float> coordinate{0.f, 1.f};
+    std::vector<std::pair<float, float>> points(10000);
+    for( auto &point: points )
+        point = {coordinate(rng), coordinate(rng)};
+    samples.clear();
+    long checksum = 0;
+    for( int i = 0; i < iterations; ++i )
+        for( auto [x, y]: points )
+            samples.push_back(TimeMicroseconds([&]{ checksum += model.FindClosestNode(x, y).Index(); }));
+    record({"latency: FindClosestNode", Summarize(samples)});
+    
+    RoutePlanner planner{model};
+    const auto queries = RoadQueries(model, 1000, seed);
+    for( auto [name, search]: {std::pair{"latency: A* search", RoutePlanner::Search::Forward},
+                               std::pair{"latency: bidirectional search", RoutePlanner::Search::Bidirectional}} ) {
+        samples.clear();
+        double expanded = 0, heap_operations = 0;
+        for( int i = 0; i < iterations; ++i )
+            for( auto &query: queries ) {
+                RoutePlanner::Result result;
+                samples.push_back(TimeMicroseconds([&]{ result = planner.Route(query.start, query.goal, search); }));
+                expanded += result.stats.expanded;
+                heap_operations += result.stats.pushed + result.stats.decreased + result.stats.expanded;
+            }
+        const auto runs = double(samples.size());
+        record({name, Summarize(samples), expanded / runs, heap_operations / runs});
+    }
+    
+    // The same searches through RouteServer, one request at a time over localhost TCP: what a
+    // client sees, parsing, queueing and the socket round trip included.
+    RouteServer server{model, 1};
+    if( server.Listen("127.0.0.1:0") ) {
+        std::thread loop{[&]{ server.Run(); }};
+        const int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(server.Port());
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if( connect(fd, (const sockaddr*)&address, sizeof(address)) == 0 ) {
+            const auto &nodes = model.SNodes();
+            samples.clear();
+            std::string answer;
+            char buffer[64 * 1024];
+            for( int i = 0; i < iterations; ++i )
+                for( auto &query: queries ) {
+                    const auto request = std::to_string(nodes[query.start].x * 100) + " " + std::to_string(nodes[query.start].y * 100) + " " +
+                                         std::to_string(nodes[query.goal].x * 100) + " " + std::to_string(nodes[query.goal].y * 100) + " forward\n";
+                    samples.push_back(TimeMicroseconds([&]{
+                        send(fd, request.data(), request.size(), 0);
+                        answer.clear();
+                        while( answer.empty() || answer.back() != '\n' ) {
+                            const auto count = recv(fd, buffer, sizeof(buffer), 0);
+                            if( count <= 0 )
+                                break;
+                            answer.append(buffer, count);
+                        }
+                    }));
+                    checksum += answer.size();
+                }
+            record({"latency: RouteServer round trip", Summarize(samples)});
+        }
+        close(fd);
+        server.Stop();
+        loop.join();
+    }
+    
+    if( checksum == 0 )
+        std::printf("latency: no points snapped\n");
+    if( !json_path.empty() && !WriteLatencyJson(json_path, osm_file, seed, iterations, records) )
+        std::cerr << "Failed to write " << json_path << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+    std::string osm_file = "../map.osm";
+    int iterations = 10;
+    unsigned seed = 1;
+    std::string json_path;
+    std::vector<std::string> suites;
+    for( int i = 1; i < argc; ++i ) {
+        auto arg = std::string_view{argv[i]};
+        if( arg == "-f" && i + 1 < argc )
+            osm_file = argv[++i];
+        else if( arg == "-n" && i + 1 < argc )
+            iterations = std::max(1, std::atoi(argv[++i]));
+        else if( arg == "-s" && i + 1 < argc )
+            seed = (unsigned)std::strtoul(argv[++i], nullptr, 10);
+        else if( arg == "-j" && i + 1 < argc )
+            json_path = argv[++i];
+        else
+            suites.emplace_back(arg);
+    }
+    auto selected = [&](std::string_view suite) {
+        return suites.empty() || std::find(suites.begin(), suites.end(), suite) != suites.end();
+    };
+    
+    const auto xml = ReadFile(osm_file).value_or(std::vector<std::byte>{});
+    if( xml.empty() ) {
+        std::cerr << "Failed to read " << osm_file << std::endl;
+        return 1;
+    }
+    
+    // First, so the peak resident set it reports is that of loading, with only the file above read.
+    if( selected("latency") )
+        BenchLatency(osm_file, iterations, seed, json_path);
+    if( selected("ids") )
+        BenchIdResolution(xml, iterations);
+    if( selected("load") )
+        BenchLoad(osm_file, xml, iterations);
+    if( selected("route") )
+        BenchRoutes(osm_file, iterations);
+    if( selected("layout") )
+        BenchLayout(osm_file, iterations);
+    if( selected("simd") )
+        BenchDistanceKernels(iterations);
+    if( selected("matrix") )
+        BenchMatrix(osm_file, iterations);
+    if( selected("snap") )
+        BenchSnap(osm_file, iterations);
+}
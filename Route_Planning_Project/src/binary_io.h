@@ -0,0 +1,152 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Native byte order sections for the on-disk snapshots (model cache, contraction hierarchy).
+// Every section is padded to 8 bytes, so the arrays of a mapped file stay aligned.
+class BinaryWriter
+{
+public:
+    template <typename T>
+    void Put(const T *data, std::size_t count)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        auto bytes = reinterpret_cast<const std::byte*>(data);
+        m_Buffer.insert(m_Buffer.end(), bytes, bytes + count * sizeof(T));
+        m_Buffer.resize((m_Buffer.size() + 7) & ~std::size_t{7}, std::byte{0});
+    }
+
+    void PutCount(std::size_t count)
+    {
+        auto value = (std::uint64_t)count;
+        Put(&value, 1);
+    }
+
+    // A count prefixed array.
+    template <typename T>
+    void PutVector(const std::vector<T> &values)
+    {
+        PutCount(values.size());
+        Put(values.data(), values.size());
+    }
+
+    void PutIndexLists(const std::vector<const std::vector<int>*> &lists)
+    {
+        std::vector<int> offsets{0}, flat;
+        for( auto list: lists ) {
+            flat.insert(flat.end(), list->begin(), list->end());
+            offsets.emplace_back((int)flat.size());
+        }
+        Put(offsets.data(), offsets.size());
+        PutCount(flat.size());
+        Put(flat.data(), flat.size());
+    }
+
+    const std::vector<std::byte> &Buffer() const noexcept { return m_Buffer; }
+
+private:
+    std::vector<std::byte> m_Buffer;
+};
+
+// Reads what BinaryWriter wrote; every getter returns false on truncated or oversized data.
+class BinaryReader
+{
+public:
+    BinaryReader(const std::byte *data, std::size_t size) : m_Data(data), m_Size(size) {}
+
+    template <typename T>
+    bool Get(T *out, std::size_t count)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if( count > (m_Size - m_Pos) / sizeof(T) )
+            return false;
+        const auto bytes = count * sizeof(T);
+        if( bytes )
+            std::memcpy(out, m_Data + m_Pos, bytes);
+        m_Pos = std::min(m_Size, (m_Pos + bytes + 7) & ~std::size_t{7});
+        return true;
+    }
+
+    bool GetCount(std::size_t &count)
+    {
+        std::uint64_t value;
+        if( !Get(&value, 1) || value > m_Size )
+            return false;
+        count = (std::size_t)value;
+        return true;
+    }
+
+    template <typename T>
+    bool GetVector(std::vector<T> &values)
+    {
+        std::size_t count;
+        if( !GetCount(count) )
+            return false;
+        values.resize(count);
+        return Get(values.data(), count);
+    }
+
+    bool GetIndexLists(std::size_t lists, std::vector<std::vector<int>> &out)
+    {
+        std::vector<int> offsets(lists + 1);
+        std::size_t flat_size;
+        if( !Get(offsets.data(), offsets.size()) || !GetCount(flat_size) )
+            return false;
+        std::vector<int> flat(flat_size);
+        if( !Get(flat.data(), flat.size()) )
+            return false;
+        out.resize(lists);
+        for( std::size_t i = 0; i < lists; ++i ) {
+            if( offsets[i] < 0 || offsets[i] > offsets[i + 1] || (std::size_t)offsets[i + 1] > flat_size )
+                return false;
+            out[i].assign(flat.begin() + offsets[i], flat.begin() + offsets[i + 1]);
+        }
+        return true;
+    }
+
+    bool AtEnd() const noexcept { return m_Pos == m_Size; }
+
+private:
+    const std::byte *m_Data;
+    std::size_t m_Size;
+    std::size_t m_Pos = 0;
+};
+
+// Writes header and payload next to path and renames the result over it, so a concurrent reader
+// never maps a partial file. The temporary file has a unique name, so processes writing the same
+// path at once each rename a complete file of their own.
+template <typename Header>
+bool WriteFileAtomically(const std::string &path, const Header &header, const std::vector<std::byte> &payload)
+{
+    static_assert(std::is_trivially_copyable_v<Header>);
+    std::string tmp_path = path + ".XXXXXX";
+    const int fd = mkstemp(tmp_path.data());
+    if( fd < 0 )
+        return false;
+    // mkstemp creates the file readable by its owner only.
+    fchmod(fd, 0644);
+    FILE *file = fdopen(fd, "wb");
+    if( !file ) {
+        close(fd);
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    bool written = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   std::fwrite(payload.data(), 1, payload.size(), file) == payload.size();
+    written = std::fclose(file) == 0 && written;
+    if( !written || std::rename(tmp_path.c_str(), path.c_str()) != 0 ) {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
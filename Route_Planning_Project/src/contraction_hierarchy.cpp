@@ -0,0 +1,305 @@
+#include "contraction_hierarchy.h"
+#include "binary_io.h"
+#include "mapped_file.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+constexpr char kMagic[8] = {'O', 'S', 'M', 'C', 'H', 'I', 'E', 'R'};
+// Bump whenever the file layout or the preprocessing changes.
+constexpr std::uint32_t kVersion = 1;
+
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t header_size;
+    std::uint64_t graph_checksum;
+    std::uint64_t payload_size;
+};
+
+// Witness searches give up after settling this many nodes. Stopping early only costs extra
+// shortcuts, never correctness.
+constexpr int kMaxSettled = 200;
+
+struct Arc {
+    int to;
+    float length;
+    int middle;
+};
+
+// Dijkstra from one neighbor of a node being contracted, around that node, looking for paths
+// that make shortcuts through it unnecessary.
+class WitnessSearch
+{
+public:
+    explicit WitnessSearch(std::size_t node_count) : m_Distances(node_count), m_Stamps(node_count, 0) {}
+
+    // Distances from source that avoid skip. Every finite distance is the length of a real path,
+    // though not necessarily the shortest once the search stopped at limit or kMaxSettled.
+    void Run(const std::vector<std::vector<Arc>> &arcs, int source, int skip, float limit)
+    {
+        m_Epoch++;
+        m_Queue.clear();
+        Set(source, 0.0f);
+        int settled = 0;
+        while (!m_Queue.empty())
+        {
+            std::pop_heap(m_Queue.begin(), m_Queue.end(), std::greater<>{});
+            const auto [distance, node] = m_Queue.back();
+            m_Queue.pop_back();
+            if (distance > Distance(node))
+                continue;
+            if (distance > limit || ++settled > kMaxSettled)
+                break;
+            for (const Arc &arc : arcs[node])
+                if (arc.to != skip && distance + arc.length < Distance(arc.to))
+                    Set(arc.to, distance + arc.length);
+        }
+    }
+
+    float Distance(int node) const
+    {
+        return m_Stamps[node] == m_Epoch ? m_Distances[node] : std::numeric_limits<float>::max();
+    }
+
+private:
+    void Set(int node, float distance)
+    {
+        m_Distances[node] = distance;
+        m_Stamps[node] = m_Epoch;
+        m_Queue.push_back({distance, node});
+        std::push_heap(m_Queue.begin(), m_Queue.end(), std::greater<>{});
+    }
+
+    std::vector<float> m_Distances;
+    std::vector<std::uint32_t> m_Stamps;
+    std::uint32_t m_Epoch = 0;
+    std::vector<std::pair<float, int>> m_Queue;
+};
+
+void AddOrShorten(std::vector<Arc> &arcs, int to, float length, int middle)
+{
+    for (Arc &arc : arcs)
+        if (arc.to == to)
+        {
+            if (length < arc.length)
+                arc = {to, length, middle};
+            return;
+        }
+    arcs.push_back({to, length, middle});
+}
+
+// Shortcuts needed to contract node given the nodes still left in arcs; adds them when add is set.
+int Contract(std::vector<std::vector<Arc>> &arcs, WitnessSearch &witness, int node, bool add)
+{
+    const auto &around = arcs[node];
+    int shortcuts = 0;
+    for (std::size_t i = 0; i + 1 < around.size(); i++)
+    {
+        float limit = 0.0f;
+        for (std::size_t j = i + 1; j < around.size(); j++)
+            limit = std::max(limit, around[i].length + around[j].length);
+        witness.Run(arcs, around[i].to, node, limit);
+        for (std::size_t j = i + 1; j < around.size(); j++)
+        {
+            const float length = around[i].length + around[j].length;
+            if (witness.Distance(around[j].to) <= length)
+                continue;
+            shortcuts++;
+            if (add)
+            {
+                AddOrShorten(arcs[around[i].to], around[j].to, length, node);
+                AddOrShorten(arcs[around[j].to], around[i].to, length, node);
+            }
+        }
+    }
+    return shortcuts;
+}
+
+}
+
+ContractionHierarchy::ContractionHierarchy(const RouteModel::Graph &graph)
+{
+    const int node_count = (int)graph.offsets.size() - 1;
+    std::vector<std::vector<Arc>> arcs(node_count);
+    for (int node = 0; node < node_count; node++)
+        for (int edge = graph.offsets[node]; edge < graph.offsets[node + 1]; edge++)
+            if (DistanceProfile::Allows(graph.types[edge]))
+                AddOrShorten(arcs[node], graph.targets[edge], graph.lengths[edge], -1);
+
+    // Contract in order of edge difference (shortcuts added minus edges removed) plus the number
+    // of neighbors already contracted, which spreads the contraction evenly over the map.
+    // Priorities only change around contracted nodes; stale ones are recomputed when they
+    // reach the top of the queue.
+    WitnessSearch witness{(std::size_t)node_count};
+    std::vector<int> contracted_neighbors(node_count, 0);
+    auto priority = [&](int node) {
+        return Contract(arcs, witness, node, false) - (int)arcs[node].size() + contracted_neighbors[node];
+    };
+    using Entry = std::pair<int, int>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    for (int node = 0; node < node_count; node++)
+        queue.push({priority(node), node});
+
+    std::vector<std::vector<Arc>> upward(node_count);
+    m_Ranks.assign(node_count, -1);
+    int rank = 0;
+    while (!queue.empty())
+    {
+        const int node = queue.top().second;
+        queue.pop();
+        const int current = priority(node);
+        if (!queue.empty() && current > queue.top().first)
+        {
+            queue.push({current, node});
+            continue;
+        }
+        Contract(arcs, witness, node, true);
+        // The neighbors left are all contracted later, so these edges lead upwards.
+        upward[node] = std::move(arcs[node]);
+        arcs[node].clear();
+        m_Ranks[node] = rank++;
+        for (const Arc &arc : upward[node])
+        {
+            auto &back = arcs[arc.to];
+            back.erase(std::find_if(back.begin(), back.end(), [&](const Arc &a) { return a.to == node; }));
+            contracted_neighbors[arc.to]++;
+        }
+    }
+
+    m_Upward.offsets.assign(1, 0);
+    for (int node = 0; node < node_count; node++)
+    {
+        for (const Arc &arc : upward[node])
+        {
+            m_Upward.targets.push_back(arc.to);
+            m_Upward.lengths.push_back(arc.length);
+            m_Upward.middles.push_back(arc.middle);
+        }
+        m_Upward.offsets.push_back((int)m_Upward.targets.size());
+    }
+}
+
+std::size_t ContractionHierarchy::Shortcuts() const noexcept
+{
+    return std::count_if(m_Upward.middles.begin(), m_Upward.middles.end(), [](int middle) { return middle != -1; });
+}
+
+int ContractionHierarchy::FindEdge(int a, int b) const
+{
+    if (m_Ranks[a] > m_Ranks[b])
+        std::swap(a, b);
+    for (int edge = m_Upward.offsets[a]; edge < m_Upward.offsets[a + 1]; edge++)
+        if (m_Upward.targets[edge] == b)
+            return edge;
+    return -1;
+}
+
+void ContractionHierarchy::Unpack(const std::vector<int> &hops, std::vector<int> &path) const
+{
+    if (hops.empty())
+        return;
+    path.push_back(hops.front());
+    // Shortcuts expand into the two edges around the node they bypass. Edges wait on a stack
+    // with the next one on top, so nodes come out in route order.
+    std::vector<std::pair<int, int>> pending;
+    for (std::size_t i = hops.size() - 1; i > 0; i--)
+        pending.push_back({hops[i - 1], hops[i]});
+    while (!pending.empty())
+    {
+        const auto [a, b] = pending.back();
+        pending.pop_back();
+        const int edge = FindEdge(a, b);
+        if (edge < 0)
+            throw std::logic_error("the contraction hierarchy has no edge between two route nodes");
+        const int middle = m_Upward.middles[edge];
+        if (middle == -1)
+        {
+            path.push_back(b);
+            continue;
+        }
+        pending.push_back({middle, b});
+        pending.push_back({a, middle});
+    }
+}
+
+bool ContractionHierarchy::Save(const std::string &path, const RouteModel::Graph &graph) const
+{
+    BinaryWriter writer;
+    writer.PutVector(m_Ranks);
+    writer.PutVector(m_Upward.offsets);
+    writer.PutVector(m_Upward.targets);
+    writer.PutVector(m_Upward.lengths);
+    writer.PutVector(m_Upward.middles);
+
+    Header header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.header_size = sizeof(Header);
+    header.graph_checksum = graph.Checksum();
+    header.payload_size = writer.Buffer().size();
+    return WriteFileAtomically(path, header, writer.Buffer());
+}
+
+bool ContractionHierarchy::Load(const std::string &path, const RouteModel::Graph &graph)
+{
+    MappedFile file{path};
+    if (!file.IsOpen() || file.Size() < sizeof(Header))
+        return false;
+
+    Header header;
+    std::memcpy(&header, file.Data(), sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+        header.version != kVersion ||
+        header.header_size != sizeof(Header) ||
+        header.graph_checksum != graph.Checksum() ||
+        header.payload_size != file.Size() - sizeof(Header))
+        return false;
+
+    BinaryReader reader{file.Data() + sizeof(Header), (std::size_t)header.payload_size};
+    ContractionHierarchy loaded;
+    auto &up = loaded.m_Upward;
+    if (!reader.GetVector(loaded.m_Ranks) || !reader.GetVector(up.offsets) || !reader.GetVector(up.targets) ||
+        !reader.GetVector(up.lengths) || !reader.GetVector(up.middles) || !reader.AtEnd())
+        return false;
+
+    // Queries trust the structure, so check everything they rely on: ranks form a permutation,
+    // edges lead upwards and every shortcut bypasses a lower node through two existing edges.
+    const auto node_count = graph.offsets.size() - 1;
+    const auto edge_count = up.targets.size();
+    if (loaded.m_Ranks.size() != node_count || up.offsets.size() != node_count + 1 || up.offsets.front() != 0 ||
+        (std::size_t)up.offsets.back() != edge_count || up.lengths.size() != edge_count || up.middles.size() != edge_count)
+        return false;
+    std::vector<bool> taken(node_count, false);
+    for (int rank : loaded.m_Ranks)
+    {
+        if (rank < 0 || (std::size_t)rank >= node_count || taken[rank])
+            return false;
+        taken[rank] = true;
+    }
+    auto valid_node = [&](int node) { return node >= 0 && (std::size_t)node < node_count; };
+    for (std::size_t node = 0; node < node_count; node++)
+        if (up.offsets[node] > up.offsets[node + 1])
+            return false;
+    for (std::size_t node = 0; node < node_count; node++)
+        for (int edge = up.offsets[node]; edge < up.offsets[node + 1]; edge++)
+        {
+            const int target = up.targets[edge], middle = up.middles[edge];
+            if (!valid_node(target) || loaded.m_Ranks[target] <= loaded.m_Ranks[node] ||
+                !std::isfinite(up.lengths[edge]) || up.lengths[edge] < 0.0f)
+                return false;
+            if (middle != -1 && (!valid_node(middle) || loaded.m_Ranks[middle] >= loaded.m_Ranks[node] ||
+                                 loaded.FindEdge(middle, (int)node) < 0 || loaded.FindEdge(middle, target) < 0))
+                return false;
+        }
+
+    *this = std::move(loaded);
+    return true;
+}
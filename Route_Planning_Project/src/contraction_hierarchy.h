@@ -0,0 +1,56 @@
+#ifndef CONTRACTION_HIERARCHY_H
+#define CONTRACTION_HIERARCHY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "route_model.h"
+
+// Contraction hierarchy over the roads of RouteModel's graph that DistanceProfile allows, so it
+// answers shortest-distance queries only. Preprocessing contracts the nodes one by
+// one, least important first, and adds a shortcut wherever contracting a node would lengthen a
+// shortest path between two of its neighbors. A query then only has to search upwards, towards
+// more important nodes, from both ends, which settles a few hundred nodes on any map size.
+//
+// The road graph is undirected, so a single upward graph serves both search directions. Every
+// edge is stored once, at its less important end.
+class ContractionHierarchy
+{
+public:
+  // Edges leaving node i are [offsets[i], offsets[i + 1]) and all lead to more important nodes.
+  // A shortcut records the contracted node it bypasses in middles, original segments store -1.
+  struct UpwardGraph
+  {
+    std::vector<int> offsets;
+    std::vector<int> targets;
+    std::vector<float> lengths; // Model units, like RouteModel::Graph.
+    std::vector<int> middles;
+  };
+
+  ContractionHierarchy() = default;
+  // Preprocesses the graph; takes a few seconds per million nodes.
+  explicit ContractionHierarchy(const RouteModel::Graph &graph);
+
+  // Loads a hierarchy written by Save. Returns false when the file is missing, damaged or was
+  // built for another graph.
+  bool Load(const std::string &path, const RouteModel::Graph &graph);
+  bool Save(const std::string &path, const RouteModel::Graph &graph) const;
+
+  const UpwardGraph &Upward() const noexcept { return m_Upward; }
+  // Position of every node in the contraction order, higher is more important.
+  const std::vector<int> &Ranks() const noexcept { return m_Ranks; }
+  std::size_t Shortcuts() const noexcept;
+
+  // Appends the road nodes of the route that visits the given hierarchy nodes in order, each
+  // joined to the next by an upward edge, starting with hops.front().
+  void Unpack(const std::vector<int> &hops, std::vector<int> &path) const;
+
+private:
+  // Index of the upward edge joining a and b, -1 when there is none.
+  int FindEdge(int a, int b) const;
+
+  std::vector<int> m_Ranks;
+  UpwardGraph m_Upward;
+};
+
+#endif
@@ -0,0 +1,215 @@
+#include "distance_kernel.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define DISTANCE_KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+double MinSquaredDistanceScalar(const double *xs, const double *ys, std::size_t count, double x, double y)
+{
+    double best = std::numeric_limits<double>::infinity();
+    for (std::size_t i = 0; i < count; i++)
+    {
+        const double dx = xs[i] - x, dy = ys[i] - y;
+        best = std::min(best, dx * dx + dy * dy);
+    }
+    return best;
+}
+
+void GatherDistancesScalar(const float *xs, const float *ys, const int *ids, std::size_t count, float x, float y,
+                           float *out)
+{
+    for (std::size_t i = 0; i < count; i++)
+    {
+        const float dx = xs[ids[i]] - x, dy = ys[ids[i]] - y;
+        out[i] = std::sqrt(dx * dx + dy * dy);
+    }
+}
+
+double PathLengthScalar(const Model::Node *nodes, const int *path, std::size_t count)
+{
+    double length = 0.0;
+    for (std::size_t i = 1; i < count; i++)
+    {
+        const double dx = nodes[path[i]].x - nodes[path[i - 1]].x, dy = nodes[path[i]].y - nodes[path[i - 1]].y;
+        length += std::sqrt(dx * dx + dy * dy);
+    }
+    return length;
+}
+
+#ifdef DISTANCE_KERNEL_X86
+
+// The AVX2 kernels clear the upper register halves with _mm256_zeroupper() before handing the
+// tail to the SSE2 code and returning: the rest of the program is not VEX encoded, and running it
+// with dirty upper halves costs a state transition per call that dwarfs a short run.
+
+// Model::Node is two adjacent doubles, which the vector code loads as one pair.
+static_assert(sizeof(Model::Node) == 2 * sizeof(double), "Model::Node must be an (x, y) pair of doubles");
+
+__attribute__((target("sse2")))
+double MinSquaredDistanceSSE2(const double *xs, const double *ys, std::size_t count, double x, double y)
+{
+    const __m128d px = _mm_set1_pd(x), py = _mm_set1_pd(y);
+    __m128d best = _mm_set1_pd(std::numeric_limits<double>::infinity());
+    std::size_t i = 0;
+    for (; i + 2 <= count; i += 2)
+    {
+        const __m128d dx = _mm_sub_pd(_mm_loadu_pd(xs + i), px), dy = _mm_sub_pd(_mm_loadu_pd(ys + i), py);
+        best = _mm_min_pd(best, _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, best);
+    return std::min({lanes[0], lanes[1], MinSquaredDistanceScalar(xs + i, ys + i, count - i, x, y)});
+}
+
+__attribute__((target("sse2")))
+void GatherDistancesSSE2(const float *xs, const float *ys, const int *ids, std::size_t count, float x, float y,
+                         float *out)
+{
+    const __m128 px = _mm_set1_ps(x), py = _mm_set1_ps(y);
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 dx = _mm_sub_ps(_mm_setr_ps(xs[ids[i]], xs[ids[i + 1]], xs[ids[i + 2]], xs[ids[i + 3]]), px);
+        const __m128 dy = _mm_sub_ps(_mm_setr_ps(ys[ids[i]], ys[ids[i + 1]], ys[ids[i + 2]], ys[ids[i + 3]]), py);
+        _mm_storeu_ps(out + i, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy))));
+    }
+    GatherDistancesScalar(xs, ys, ids + i, count - i, x, y, out + i);
+}
+
+__attribute__((target("sse2")))
+double PathLengthSSE2(const Model::Node *nodes, const int *path, std::size_t count)
+{
+    // Two segments per step: the (dx, dy) pairs of both are transposed into (dx1, dx2) and
+    // (dy1, dy2) so one square root covers both.
+    __m128d sum = _mm_setzero_pd();
+    std::size_t i = 1;
+    for (; i + 2 <= count; i += 2)
+    {
+        const __m128d a = _mm_loadu_pd(&nodes[path[i - 1]].x), b = _mm_loadu_pd(&nodes[path[i]].x);
+        const __m128d c = _mm_loadu_pd(&nodes[path[i + 1]].x);
+        const __m128d d1 = _mm_sub_pd(b, a), d2 = _mm_sub_pd(c, b);
+        const __m128d dx = _mm_unpacklo_pd(d1, d2), dy = _mm_unpackhi_pd(d1, d2);
+        sum = _mm_add_pd(sum, _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy))));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, sum);
+    return lanes[0] + lanes[1] + PathLengthScalar(nodes, path + i - 1, count - (i - 1));
+}
+
+__attribute__((target("avx2")))
+double MinSquaredDistanceAVX2(const double *xs, const double *ys, std::size_t count, double x, double y)
+{
+    const __m256d px = _mm256_set1_pd(x), py = _mm256_set1_pd(y);
+    __m256d best = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(xs + i), px), dy = _mm256_sub_pd(_mm256_loadu_pd(ys + i), py);
+        best = _mm256_min_pd(best, _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, best);
+    _mm256_zeroupper();
+    return std::min({lanes[0], lanes[1], lanes[2], lanes[3], MinSquaredDistanceSSE2(xs + i, ys + i, count - i, x, y)});
+}
+
+__attribute__((target("avx2")))
+void GatherDistancesAVX2(const float *xs, const float *ys, const int *ids, std::size_t count, float x, float y,
+                         float *out)
+{
+    const __m256 px = _mm256_set1_ps(x), py = _mm256_set1_ps(y);
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m256i index = _mm256_loadu_si256((const __m256i *)(ids + i));
+        const __m256 dx = _mm256_sub_ps(_mm256_i32gather_ps(xs, index, 4), px);
+        const __m256 dy = _mm256_sub_ps(_mm256_i32gather_ps(ys, index, 4), py);
+        _mm256_storeu_ps(out + i, _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy))));
+    }
+    _mm256_zeroupper();
+    GatherDistancesSSE2(xs, ys, ids + i, count - i, x, y, out + i);
+}
+
+// _mm256_i32gather_pd with a defined source, which keeps GCC from warning about the undefined
+// one the plain intrinsic passes.
+__attribute__((target("avx2")))
+inline __m256d GatherPd(const double *base, __m128i index)
+{
+    const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), base, index, all, 8);
+}
+
+__attribute__((target("avx2")))
+double PathLengthAVX2(const Model::Node *nodes, const int *path, std::size_t count)
+{
+    // Four segments per step, gathering x and y of both ends: node n's x is double 2n of the
+    // node array and its y double 2n + 1.
+    const double *base = &nodes[0].x;
+    const __m128i one = _mm_set1_epi32(1);
+    __m256d sum = _mm256_setzero_pd();
+    std::size_t i = 1;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128i from = _mm_slli_epi32(_mm_loadu_si128((const __m128i *)(path + i - 1)), 1);
+        const __m128i to = _mm_slli_epi32(_mm_loadu_si128((const __m128i *)(path + i)), 1);
+        const __m256d dx = _mm256_sub_pd(GatherPd(base, to), GatherPd(base, from));
+        const __m256d dy = _mm256_sub_pd(GatherPd(base, _mm_add_epi32(to, one)), GatherPd(base, _mm_add_epi32(from, one)));
+        sum = _mm256_add_pd(sum, _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy))));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, sum);
+    _mm256_zeroupper();
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + PathLengthSSE2(nodes, path + i - 1, count - (i - 1));
+}
+
+#endif
+
+const DistanceKernels kScalar{SimdLevel::Scalar, MinSquaredDistanceScalar, GatherDistancesScalar, PathLengthScalar};
+#ifdef DISTANCE_KERNEL_X86
+const DistanceKernels kSSE2{SimdLevel::SSE2, MinSquaredDistanceSSE2, GatherDistancesSSE2, PathLengthSSE2};
+const DistanceKernels kAVX2{SimdLevel::AVX2, MinSquaredDistanceAVX2, GatherDistancesAVX2, PathLengthAVX2};
+#endif
+
+SimdLevel DetectSimdLevel()
+{
+#ifdef DISTANCE_KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return SimdLevel::SSE2;
+#endif
+    return SimdLevel::Scalar;
+}
+
+}
+
+SimdLevel HostSimdLevel()
+{
+    static const SimdLevel level = DetectSimdLevel();
+    return level;
+}
+
+const DistanceKernels &GetDistanceKernels(SimdLevel level)
+{
+    level = std::min(level, HostSimdLevel());
+#ifdef DISTANCE_KERNEL_X86
+    if (level == SimdLevel::AVX2)
+        return kAVX2;
+    if (level == SimdLevel::SSE2)
+        return kSSE2;
+#endif
+    return kScalar;
+}
+
+const DistanceKernels &GetDistanceKernels()
+{
+    static const DistanceKernels &kernels = GetDistanceKernels(HostSimdLevel());
+    return kernels;
+}
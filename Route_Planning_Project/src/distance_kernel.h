@@ -0,0 +1,37 @@
+#ifndef DISTANCE_KERNEL_H
+#define DISTANCE_KERNEL_H
+
+#include <cstddef>
+#include "model.h"
+
+// Instruction sets the distance kernels are written for, in increasing order.
+enum class SimdLevel
+{
+  Scalar,
+  SSE2,
+  AVX2,
+};
+
+// Straight-line distance kernels over many points at once. Every level computes the same
+// per-point expressions as the scalar code, so results only differ in the order sums are added.
+struct DistanceKernels
+{
+  SimdLevel level;
+  // Smallest squared distance from (x, y) to (xs[i], ys[i]) for i < count, infinity for count 0.
+  double (*min_squared_distance)(const double *xs, const double *ys, std::size_t count, double x, double y);
+  // out[i] = distance from (x, y) to (xs[ids[i]], ys[ids[i]]) for i < count.
+  void (*gather_distances)(const float *xs, const float *ys, const int *ids, std::size_t count, float x, float y,
+                           float *out);
+  // Sum of the distances between consecutive nodes of path, which has count entries.
+  double (*path_length)(const Model::Node *nodes, const int *path, std::size_t count);
+};
+
+// Best level the CPU running the program supports, detected once.
+SimdLevel HostSimdLevel();
+
+// Kernels of the given level, or of the highest lower one this build and the CPU support.
+const DistanceKernels &GetDistanceKernels(SimdLevel level);
+// Kernels of HostSimdLevel().
+const DistanceKernels &GetDistanceKernels();
+
+#endif
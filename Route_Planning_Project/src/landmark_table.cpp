@@ -0,0 +1,147 @@
+#include "landmark_table.h"
+#include "binary_io.h"
+#include "mapped_file.h"
+#include "open_list.h"
+#include <cstring>
+#include <limits>
+
+namespace {
+
+constexpr char kMagic[8] = {'O', 'S', 'M', 'L', 'A', 'N', 'D', 'M'};
+// Bump whenever the file layout or the landmark selection changes.
+constexpr std::uint32_t kVersion = 1;
+
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t header_size;
+    std::uint64_t graph_checksum;
+    std::uint64_t payload_size;
+};
+
+// Road distances from source to every node, infinite for nodes it cannot reach.
+void ShortestDistances(const RouteModel::Graph &graph, int source, OpenList &open_list, std::vector<float> &distances)
+{
+    const int node_count = (int)graph.offsets.size() - 1;
+    distances.assign(node_count, std::numeric_limits<float>::infinity());
+    open_list.Reset(node_count);
+    distances[source] = 0.0f;
+    open_list.Push(source, 0.0f);
+    while (!open_list.Empty())
+    {
+        const int node = open_list.Pop();
+        for (int edge = graph.offsets[node]; edge < graph.offsets[node + 1]; edge++)
+        {
+            if (!DistanceProfile::Allows(graph.types[edge]))
+                continue;
+            const int target = graph.targets[edge];
+            const float distance = distances[node] + graph.lengths[edge];
+            if (distance >= distances[target])
+                continue;
+            if (open_list.Contains(target))
+                open_list.DecreaseKey(target, distance);
+            else
+                open_list.Push(target, distance);
+            distances[target] = distance;
+        }
+    }
+}
+
+}
+
+LandmarkTable::LandmarkTable(const RouteModel::Graph &graph, int count)
+{
+    const int node_count = (int)graph.offsets.size() - 1;
+    auto routable = [&](int node) {
+        for (int edge = graph.offsets[node]; edge < graph.offsets[node + 1]; edge++)
+            if (DistanceProfile::Allows(graph.types[edge]))
+                return true;
+        return false;
+    };
+
+    // Farthest-point selection: the first landmark is the node farthest from an arbitrary start
+    // and every later one is the node farthest from all landmarks so far. Nodes no landmark
+    // reaches count as infinitely far, so every connected part of the network gets landmarks.
+    int seed = 0;
+    while (seed < node_count && !routable(seed))
+        seed++;
+    if (seed == node_count)
+        return;
+    OpenList open_list;
+    std::vector<float> closest, distances;
+    ShortestDistances(graph, seed, open_list, closest);
+
+    std::vector<std::vector<float>> tables;
+    for (int i = 0; i < count; i++)
+    {
+        int landmark = -1;
+        for (int node = 0; node < node_count; node++)
+            if (routable(node) && (landmark < 0 || closest[node] > closest[landmark]))
+                landmark = node;
+        if (closest[landmark] <= 0.0f)
+            break;
+        ShortestDistances(graph, landmark, open_list, distances);
+        for (int node = 0; node < node_count; node++)
+            closest[node] = i == 0 ? distances[node] : std::min(closest[node], distances[node]);
+        m_Landmarks.push_back(landmark);
+        tables.push_back(distances);
+    }
+
+    m_Distances.resize(std::size_t(node_count) * m_Landmarks.size());
+    for (int node = 0; node < node_count; node++)
+        for (std::size_t i = 0; i < m_Landmarks.size(); i++)
+        {
+            const float distance = tables[i][node];
+            m_Distances[node * m_Landmarks.size() + i] = distance < std::numeric_limits<float>::infinity() ? distance : kUnreachable;
+        }
+}
+
+bool LandmarkTable::Save(const std::string &path, const RouteModel::Graph &graph) const
+{
+    BinaryWriter writer;
+    writer.PutVector(m_Landmarks);
+    writer.PutVector(m_Distances);
+
+    Header header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.header_size = sizeof(Header);
+    header.graph_checksum = graph.Checksum();
+    header.payload_size = writer.Buffer().size();
+    return WriteFileAtomically(path, header, writer.Buffer());
+}
+
+bool LandmarkTable::Load(const std::string &path, const RouteModel::Graph &graph)
+{
+    MappedFile file{path};
+    if (!file.IsOpen() || file.Size() < sizeof(Header))
+        return false;
+
+    Header header;
+    std::memcpy(&header, file.Data(), sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+        header.version != kVersion ||
+        header.header_size != sizeof(Header) ||
+        header.graph_checksum != graph.Checksum() ||
+        header.payload_size != file.Size() - sizeof(Header))
+        return false;
+
+    BinaryReader reader{file.Data() + sizeof(Header), (std::size_t)header.payload_size};
+    std::vector<int> landmarks;
+    std::vector<float> distances;
+    if (!reader.GetVector(landmarks) || !reader.GetVector(distances) || !reader.AtEnd())
+        return false;
+    const auto node_count = graph.offsets.size() - 1;
+    if (distances.size() != node_count * landmarks.size())
+        return false;
+    for (int landmark : landmarks)
+        if (landmark < 0 || (std::size_t)landmark >= node_count)
+            return false;
+    for (float distance : distances)
+        if (!std::isfinite(distance) || (distance < 0.0f && distance != kUnreachable))
+            return false;
+
+    m_Landmarks = std::move(landmarks);
+    m_Distances = std::move(distances);
+    return true;
+}
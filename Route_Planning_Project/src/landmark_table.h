@@ -0,0 +1,52 @@
+#ifndef LANDMARK_TABLE_H
+#define LANDMARK_TABLE_H
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+#include "route_model.h"
+
+// Road distances from a few landmark nodes to every node, for the ALT (A*, landmarks, triangle
+// inequality) heuristic. For any landmark L, |d(L, v) - d(L, goal)| never exceeds the road
+// distance between v and goal, and unlike the straight-line distance it accounts for detours
+// the street network forces. Distances are over the roads DistanceProfile allows, which makes
+// the bounds valid for every profile using those roads. Roads are undirected, so one table per
+// landmark serves both directions.
+class LandmarkTable
+{
+public:
+  LandmarkTable() = default;
+  // Picks count landmarks spread over the road graph, each as far from the previous ones as
+  // possible, and computes their distance tables.
+  LandmarkTable(const RouteModel::Graph &graph, int count);
+
+  // Loads a table written by Save. Returns false when the file is missing, damaged or was
+  // built for another graph.
+  bool Load(const std::string &path, const RouteModel::Graph &graph);
+  bool Save(const std::string &path, const RouteModel::Graph &graph) const;
+
+  const std::vector<int> &Nodes() const noexcept { return m_Landmarks; }
+
+  // Lower bound on the road distance between two nodes in model units.
+  float LowerBound(int node, int goal) const
+  {
+    const std::size_t count = m_Landmarks.size();
+    const float *from = m_Distances.data() + node * count;
+    const float *to = m_Distances.data() + goal * count;
+    float bound = 0.0f;
+    for (std::size_t i = 0; i < count; i++)
+      if (from[i] >= 0.0f && to[i] >= 0.0f)
+        bound = std::max(bound, std::abs(from[i] - to[i]));
+    return bound;
+  }
+
+private:
+  std::vector<int> m_Landmarks;
+  // Node-major: the distances of node v to all landmarks are adjacent, so a bound reads two
+  // short runs. Nodes a landmark cannot reach store kUnreachable.
+  std::vector<float> m_Distances;
+  static constexpr float kUnreachable = -1.0f;
+};
+
+#endif
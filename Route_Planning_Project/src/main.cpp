@@ -1,58 +1,220 @@
-#include <optional>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <vector>
 #include <string>
+#include <utility>
+#include <csignal>
 #include <io2d.h>
+#include "route_batch.h"
 #include "route_model.h"
 #include "render.h"
 #include "route_planner.h"
+#include "route_server.h"
 
 using namespace std::experimental;
 
-static std::optional<std::vector<std::byte>> ReadFile(const std::string &path)
-{
-    std::ifstream is{path, std::ios::binary | std::ios::ate};
-    if (!is)
-        return std::nullopt;
-
-    auto size = is.tellg();
-    std::vector<std::byte> contents(size);
-
-    is.seekg(0);
-    is.read((char *)contents.data(), size);
+static RouteServer *g_Server = nullptr;
 
-    if (contents.empty())
-        return std::nullopt;
-    return std::move(contents);
+// Parses the argument of option as a whole decimal number in [min, max], printing a usage error
+// when it is anything else.
+static bool ParseNumber(const char *option, const char *text, long min, long max, long &value)
+{
+    char *end = nullptr;
+    errno = 0;
+    value = std::strtol(text, &end, 10);
+    if (end == text || *end || errno == ERANGE || value < min || value > max)
+    {
+        std::cerr << option << " takes a number from " << min << " to " << max << ", not " << text << std::endl;
+        return false;
+    }
+    return true;
 }
 
 int main(int argc, const char **argv)
 {
     std::string osm_data_file = "";
+    std::string hierarchy_file = "";
+    std::string landmarks_file = "";
+    std::string server_address = "";
+    std::string batch_file = "";
+    std::string batch_output = "";
+    bool batch_polylines = false;
+    std::string tile_directory = "";
+    int tile_zoom = 4;
+    unsigned workers = 0;
+    bool preprocess_only = false;
+    Profile profile = Profile::Distance;
+    ModelOptions model_options;
     if (argc > 1)
     {
         for (int i = 1; i < argc; ++i)
             if (std::string_view{argv[i]} == "-f" && ++i < argc)
                 osm_data_file = argv[i];
+            else if (std::string_view{argv[i]} == "-c" && ++i < argc)
+                model_options.cache_path = argv[i];
+            else if (std::string_view{argv[i]} == "-j" && ++i < argc)
+            {
+                long threads;
+                if (!ParseNumber("-j", argv[i], 0, 1024, threads))
+                    return 1;
+                model_options.threads = (unsigned)threads;
+            }
+            else if (std::string_view{argv[i]} == "-x" && ++i < argc)
+                hierarchy_file = argv[i];
+            else if (std::string_view{argv[i]} == "-l" && ++i < argc)
+                landmarks_file = argv[i];
+            else if (std::string_view{argv[i]} == "-d" && ++i < argc)
+                server_address = argv[i];
+            else if (std::string_view{argv[i]} == "-w" && ++i < argc)
+            {
+                long threads;
+                if (!ParseNumber("-w", argv[i], 0, 1024, threads))
+                    return 1;
+                workers = (unsigned)threads;
+            }
+            else if (std::string_view{argv[i]} == "-b" && ++i < argc)
+                batch_file = argv[i];
+            else if (std::string_view{argv[i]} == "-o" && ++i < argc)
+                batch_output = argv[i];
+            else if (std::string_view{argv[i]} == "-t" && ++i < argc)
+                tile_directory = argv[i];
+            else if (std::string_view{argv[i]} == "-z" && ++i < argc)
+            {
+                long zoom;
+                if (!ParseNumber("-z", argv[i], 0, 64, zoom))
+                    return 1;
+                tile_zoom = (int)zoom;
+            }
+            else if (std::string_view{argv[i]} == "-e")
+                batch_polylines = true;
+            else if (std::string_view{argv[i]} == "-p")
+                preprocess_only = true;
+            else if (std::string_view{argv[i]} == "-s")
+                model_options.reorder_nodes = true;
+            else if (std::string_view{argv[i]} == "-r" && ++i < argc)
+            {
+                const std::string_view name{argv[i]};
+                profile = name == "car" ? Profile::Car : name == "bike" ? Profile::Bike : name == "foot" ? Profile::Foot : Profile::Distance;
+            }
     }
     else
     {
         std::cout << "To specify a map file use the following format: " << std::endl;
-        std::cout << "Usage: [executable] [-f filename.osm]" << std::endl;
+        std::cout << "Usage: [executable] [-f filename.osm] [-c model_cache.bin] [-j parse_threads] [-x hierarchy.ch] [-l landmarks.bin] [-p] [-r car|bike|foot] [-s] [-d unix:path|[host:]port] [-b queries.csv [-o results.csv] [-e]] [-t tile_dir [-z max_zoom]] [-w workers]" << std::endl;
         osm_data_file = "../map.osm";
     }
 
-    std::vector<std::byte> osm_data;
+    // Build Model, streaming the OpenStreetMap data from disk.
+    std::cout << "Reading OpenStreetMap data from the following file: " << osm_data_file << std::endl;
+    RouteModel model{osm_data_file, model_options};
+    if (model.LoadedFromCache())
+        std::cout << "Loaded model from cache: " << model_options.cache_path << std::endl;
 
-    if (osm_data.empty() && !osm_data_file.empty())
+    // Use the contraction hierarchy stored next to the model, preprocessing it on the first run.
+    if (!hierarchy_file.empty() && !model.LoadHierarchy(hierarchy_file))
+    {
+        std::cout << "Building contraction hierarchy: " << hierarchy_file << std::endl;
+        if (!model.BuildHierarchy(hierarchy_file))
+            std::cout << "Failed to write the contraction hierarchy." << std::endl;
+    }
+    // Likewise for the landmark tables of the A* heuristic.
+    if (!landmarks_file.empty() && !model.LoadLandmarks(landmarks_file))
     {
-        std::cout << "Reading OpenStreetMap data from the following file: " << osm_data_file << std::endl;
-        auto data = ReadFile(osm_data_file);
-        if (!data)
-            std::cout << "Failed to read." << std::endl;
-        else
-            osm_data = std::move(*data);
+        std::cout << "Building landmark tables: " << landmarks_file << std::endl;
+        if (!model.BuildLandmarks(16, landmarks_file))
+            std::cout << "Failed to write the landmark tables." << std::endl;
+    }
+    if (preprocess_only)
+        return 0;
+
+    // Tiles: draw the map offscreen into a pyramid of PNG tiles, see Render::RenderTiles.
+    if (!tile_directory.empty())
+    {
+        Render render{model};
+        if (tile_zoom > render.MaxTileZoom())
+        {
+            std::cerr << "-z " << tile_zoom << " is too deep for this map; its tiles go down to level "
+                      << render.MaxTileZoom() << "." << std::endl;
+            return 1;
+        }
+        const auto begin = std::chrono::steady_clock::now();
+        std::size_t tiles = 0;
+        try
+        {
+            tiles = render.RenderTiles(tile_directory, tile_zoom, workers);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Failed to render tiles into " << tile_directory << ": " << e.what() << std::endl;
+            return 1;
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+        std::cout << "Rendered " << tiles << " tiles of zoom levels 0 to " << tile_zoom << " into " << tile_directory
+                  << " in " << elapsed.count() << " s." << std::endl;
+        return 0;
+    }
+
+    // Batch: route every row of a CSV file across all workers, see route_batch.h.
+    if (!batch_file.empty())
+    {
+        std::ifstream queries{batch_file};
+        if (!queries)
+        {
+            std::cerr << "Failed to open " << batch_file << std::endl;
+            return 1;
+        }
+        // Large buffers, so the results go out in few writes.
+        std::vector<char> buffer(1 << 20);
+        std::ofstream results;
+        results.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+        if (!batch_output.empty())
+        {
+            results.open(batch_output);
+            if (!results)
+            {
+                std::cerr << "Failed to open " << batch_output << std::endl;
+                return 1;
+            }
+        }
+        BatchOptions options;
+        options.search = model.Hierarchy() || !model.Landmarks() ? RoutePlanner::Search::Hierarchy : RoutePlanner::Search::Landmarks;
+        options.profile = profile;
+        options.polylines = batch_polylines;
+        RouteEngine engine{model, workers};
+        const auto begin = std::chrono::steady_clock::now();
+        const auto summary = RouteBatch(model, engine, queries, batch_output.empty() ? std::cout : results, options);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+        std::cerr << "Routed " << summary.rows << " rows in " << elapsed.count() << " s on " << engine.Threads()
+                  << " threads: " << summary.unroutable << " without a route, " << summary.malformed << " malformed." << std::endl;
+        // Closed here rather than by the destructor, so a failure to write the last buffer is seen.
+        if (results.is_open())
+            results.close();
+        if (results.fail() || std::cout.fail())
+        {
+            std::cerr << "Failed to write " << (batch_output.empty() ? "the results" : batch_output) << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // Headless: answer route requests on a socket until interrupted, see route_server.h.
+    if (!server_address.empty())
+    {
+        RouteServer server{model, workers};
+        if (!server.Listen(server_address))
+        {
+            std::cerr << "Failed to listen on " << server_address << std::endl;
+            return 1;
+        }
+        std::cout << "Serving routes on " << server_address << std::endl;
+        g_Server = &server;
+        std::signal(SIGINT, [](int) { g_Server->Stop(); });
+        std::signal(SIGTERM, [](int) { g_Server->Stop(); });
+        server.Run();
+        return 0;
     }
 
     // TODO 1: Declare floats `start_x`, `start_y`, `end_x`, and `end_y` and get
@@ -74,14 +236,16 @@ int main(int argc, const char **argv)
               << "\n";
     std::cin >> end_y;
 
-    // Build Model.
-    RouteModel model{osm_data};
+    // Create RoutePlanner object and perform the search: the hierarchy when there is one,
+    // otherwise A*, with landmark bounds when there are some. Both fall back to plain A* for
+    // profiles they do not cover.
+    RoutePlanner route_planner{model};
+    auto search = model.Hierarchy() || !model.Landmarks() ? RoutePlanner::Search::Hierarchy : RoutePlanner::Search::Landmarks;
+    auto route = route_planner.Route(start_x, start_y, end_x, end_y, search, profile);
+    model.path = std::move(route.path);
 
-    // Create RoutePlanner object and perform A* search.
-    RoutePlanner route_planner{model, start_x, start_y, end_x, end_y};
-    route_planner.AStarSearch();
-
-    std::cout << "Distance: " << route_planner.GetDistance() << " meters. \n";
+    std::cout << "Distance: " << route.distance << " meters. \n";
+    std::cout << "Travel time: " << route.seconds / 60.0f << " minutes. \n";
 
     // Render results of search.
     Render render{model};
@@ -92,4 +256,10 @@ int main(int argc, const char **argv)
     display.draw_callback([&](io2d::output_surface &surface)
                           { render.Display(surface); });
     display.begin_show();
+
+    const auto &frames = render.Frames();
+    if (frames.frames > 0)
+        std::cout << "Drew " << frames.frames << " frames: " << frames.total_ms / frames.frames << " ms on average, "
+                  << frames.max_ms << " ms at most, " << frames.rebuild_ms << " ms in all rebuilding paths after resizes."
+                  << std::endl;
 }
@@ -0,0 +1,50 @@
+#include "mapped_file.h"
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MAPPED_FILE_USE_MMAP 1
+#endif
+
+MappedFile::MappedFile( const std::string &path )
+{
+#ifdef MAPPED_FILE_USE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if( fd < 0 )
+        return;
+    struct stat st;
+    if( ::fstat(fd, &st) == 0 && st.st_size > 0 ) {
+        auto addr = ::mmap(nullptr, (std::size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if( addr != MAP_FAILED ) {
+            m_Data = static_cast<const std::byte*>(addr);
+            m_Size = (std::size_t)st.st_size;
+            m_Mapped = true;
+        }
+    }
+    ::close(fd);
+#else
+    std::ifstream is{path, std::ios::binary | std::ios::ate};
+    if( !is )
+        return;
+    auto size = is.tellg();
+    if( size <= 0 )
+        return;
+    m_Contents.resize((std::size_t)size);
+    is.seekg(0);
+    if( !is.read((char*)m_Contents.data(), size) )
+        return;
+    m_Data = m_Contents.data();
+    m_Size = m_Contents.size();
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef MAPPED_FILE_USE_MMAP
+    if( m_Mapped )
+        ::munmap(const_cast<std::byte*>(m_Data), m_Size);
+#endif
+}
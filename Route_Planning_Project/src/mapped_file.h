@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Read-only view of a whole file. The file is memory mapped where the platform supports it and
+// read into memory otherwise, so callers only ever see a contiguous byte range.
+class MappedFile
+{
+public:
+    explicit MappedFile( const std::string &path );
+    ~MappedFile();
+    
+    MappedFile( const MappedFile & ) = delete;
+    MappedFile &operator=( const MappedFile & ) = delete;
+    
+    bool IsOpen() const noexcept { return m_Data != nullptr; }
+    const std::byte *Data() const noexcept { return m_Data; }
+    std::size_t Size() const noexcept { return m_Size; }
+    
+private:
+    const std::byte *m_Data = nullptr;
+    std::size_t m_Size = 0;
+    bool m_Mapped = false;
+    std::vector<std::byte> m_Contents;
+};
@@ -0,0 +1,169 @@
+#include "matrix_engine.h"
+#include "contraction_hierarchy.h"
+#include <algorithm>
+#include <stdexcept>
+
+MatrixEngine::MatrixEngine(const RouteModel &model, unsigned threads) : m_Model(model), m_Pool(threads)
+{
+    for (unsigned worker = 0; worker < m_Pool.Size(); worker++)
+        m_Workers.emplace_back(std::make_unique<Worker>());
+}
+
+MatrixEngine::Matrix MatrixEngine::Compute(const std::vector<int> &sources, const std::vector<int> &targets, Method method)
+{
+    const int node_count = m_Model.SNodes().size();
+    auto valid = [&](int node) { return node >= 0 && node < node_count; };
+    if (!std::all_of(sources.begin(), sources.end(), valid) || !std::all_of(targets.begin(), targets.end(), valid))
+        throw std::logic_error("distance matrix node index out of range");
+    if (method == Method::Hierarchy && !m_Model.Hierarchy())
+        throw std::logic_error("distance matrix needs a contraction hierarchy");
+
+    Matrix matrix;
+    matrix.rows = sources.size();
+    matrix.columns = targets.size();
+    matrix.meters.assign(matrix.rows * matrix.columns, Matrix::kUnreachable);
+    if (method == Method::Dijkstra || (method == Method::Auto && !m_Model.Hierarchy()))
+        ComputeDijkstra(sources, targets, matrix);
+    else
+        ComputeHierarchy(sources, targets, matrix);
+    return matrix;
+}
+
+void MatrixEngine::ComputeDijkstra(const std::vector<int> &sources, const std::vector<int> &targets, Matrix &matrix)
+{
+    // Columns for the same node share a slot, so every search waits for distinct nodes only.
+    const auto node_count = m_Model.SNodes().size();
+    std::vector<int> slot_of(node_count, -1), column_slots(targets.size());
+    int slots = 0;
+    for (std::size_t column = 0; column < targets.size(); column++)
+    {
+        if (slot_of[targets[column]] < 0)
+            slot_of[targets[column]] = slots++;
+        column_slots[column] = slot_of[targets[column]];
+    }
+
+    const auto &graph = m_Model.RoadGraph();
+    const float scale = m_Model.MetricScale();
+    m_Pool.ParallelFor(sources.size(), [&](std::size_t row, unsigned index) {
+        Worker &worker = *m_Workers[index];
+        auto &workspace = worker.workspace;
+        auto &open_list = worker.open_list;
+        worker.distances.assign(slots, Matrix::kUnreachable);
+        workspace.Reset(node_count);
+        open_list.Reset(node_count);
+        workspace.Visit(sources[row], -1, 0.0f, 0.0f);
+        open_list.Push(sources[row], 0.0f);
+
+        /* Dijkstra until every target is settled or nothing is left to reach */
+        int remaining = slots;
+        while (!open_list.Empty() && remaining > 0)
+        {
+            const int current_node = open_list.Pop();
+            workspace.Close(current_node);
+            const float current_g = workspace.G(current_node);
+            if (slot_of[current_node] >= 0)
+            {
+                worker.distances[slot_of[current_node]] = current_g * scale;
+                remaining--;
+            }
+            for (int edge = graph.offsets[current_node]; edge < graph.offsets[current_node + 1]; edge++)
+            {
+                const int node = graph.targets[edge];
+                if (!DistanceProfile::Allows(graph.types[edge]) || workspace.Closed(node))
+                    continue;
+                const float g = current_g + graph.lengths[edge];
+                if (!workspace.Visited(node))
+                {
+                    workspace.Visit(node, current_node, g, 0.0f);
+                    open_list.Push(node, g);
+                }
+                else if (g < workspace.G(node))
+                {
+                    workspace.Visit(node, current_node, g, 0.0f);
+                    open_list.DecreaseKey(node, g);
+                }
+            }
+        }
+        for (std::size_t column = 0; column < targets.size(); column++)
+            matrix.meters[row * matrix.columns + column] = worker.distances[column_slots[column]];
+    });
+}
+
+void MatrixEngine::UpwardSearch(int node, Worker &worker) const
+{
+    const auto &upward = m_Model.Hierarchy()->Upward();
+    auto &workspace = worker.workspace;
+    auto &open_list = worker.open_list;
+    const auto node_count = m_Model.SNodes().size();
+    workspace.Reset(node_count);
+    open_list.Reset(node_count);
+    worker.settled.clear();
+    workspace.Visit(node, -1, 0.0f, 0.0f);
+    open_list.Push(node, 0.0f);
+    while (!open_list.Empty())
+    {
+        const int current_node = open_list.Pop();
+        workspace.Close(current_node);
+        const float current_g = workspace.G(current_node);
+        worker.settled.push_back({current_node, current_g});
+        for (int edge = upward.offsets[current_node]; edge < upward.offsets[current_node + 1]; edge++)
+        {
+            const int next = upward.targets[edge];
+            if (workspace.Closed(next))
+                continue;
+            const float g = current_g + upward.lengths[edge];
+            if (!workspace.Visited(next))
+            {
+                workspace.Visit(next, current_node, g, 0.0f);
+                open_list.Push(next, g);
+            }
+            else if (g < workspace.G(next))
+            {
+                workspace.Visit(next, current_node, g, 0.0f);
+                open_list.DecreaseKey(next, g);
+            }
+        }
+    }
+}
+
+void MatrixEngine::ComputeHierarchy(const std::vector<int> &sources, const std::vector<int> &targets, Matrix &matrix)
+{
+    // Every shortest route climbs from its source and descends to its target through the most
+    // important node on it, which both upward searches settle. Targets leave (column, distance)
+    // in the bucket of every node they settle; a source then combines its own distances with
+    // the buckets of the nodes it settles.
+    struct Entry
+    {
+        int column;
+        float distance;
+    };
+    const auto node_count = m_Model.SNodes().size();
+    std::vector<std::vector<std::pair<int, float>>> spaces(targets.size());
+    m_Pool.ParallelFor(targets.size(), [&](std::size_t column, unsigned index) {
+        UpwardSearch(targets[column], *m_Workers[index]);
+        spaces[column] = m_Workers[index]->settled;
+    });
+
+    std::vector<int> bucket_offsets(node_count + 1, 0);
+    for (const auto &space : spaces)
+        for (const auto &[node, distance] : space)
+            bucket_offsets[node + 1]++;
+    for (std::size_t node = 0; node < node_count; node++)
+        bucket_offsets[node + 1] += bucket_offsets[node];
+    std::vector<Entry> buckets(bucket_offsets.back());
+    std::vector<int> next(bucket_offsets.begin(), bucket_offsets.end() - 1);
+    for (std::size_t column = 0; column < spaces.size(); column++)
+        for (const auto &[node, distance] : spaces[column])
+            buckets[next[node]++] = {(int)column, distance};
+    spaces.clear();
+
+    const float scale = m_Model.MetricScale();
+    m_Pool.ParallelFor(sources.size(), [&](std::size_t row, unsigned index) {
+        Worker &worker = *m_Workers[index];
+        UpwardSearch(sources[row], worker);
+        float *meters = matrix.meters.data() + row * matrix.columns;
+        for (const auto &[node, distance] : worker.settled)
+            for (int i = bucket_offsets[node]; i < bucket_offsets[node + 1]; i++)
+                meters[buckets[i].column] = std::min(meters[buckets[i].column], (distance + buckets[i].distance) * scale);
+    });
+}
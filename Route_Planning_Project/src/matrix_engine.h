@@ -0,0 +1,69 @@
+#ifndef MATRIX_ENGINE_H
+#define MATRIX_ENGINE_H
+
+#include <limits>
+#include <memory>
+#include <vector>
+#include "open_list.h"
+#include "route_model.h"
+#include "search_workspace.h"
+#include "thread_pool.h"
+
+// Road distances between every source and every target of two node lists, over the roads
+// DistanceProfile allows, computed on a pool of worker threads. Without a contraction hierarchy
+// each source runs one Dijkstra search that stops once it has settled every target. With one,
+// every target first leaves its upward search space in per-node buckets and each source then only
+// scans the buckets on its own upward search space, so a row costs a few hundred node visits
+// whatever the map size.
+class MatrixEngine
+{
+public:
+  enum class Method
+  {
+    Auto,      // Hierarchy when the model has one, Dijkstra otherwise.
+    Dijkstra,  // One-to-many Dijkstra per source.
+    Hierarchy, // Bucket-based many-to-many on the model's hierarchy.
+  };
+
+  // Dense row-major table, one row per source and one column per target.
+  struct Matrix
+  {
+    static constexpr float kUnreachable = std::numeric_limits<float>::infinity();
+
+    std::size_t rows = 0;
+    std::size_t columns = 0;
+    std::vector<float> meters; // kUnreachable where the target cannot be reached.
+
+    float At(std::size_t row, std::size_t column) const { return meters[row * columns + column]; }
+  };
+
+  // threads == 0 uses one worker per hardware thread.
+  explicit MatrixEngine(const RouteModel &model, unsigned threads = 0);
+
+  unsigned Threads() const noexcept { return m_Pool.Size(); }
+
+  // Distances between node indices of the model. Throws std::logic_error when Method::Hierarchy
+  // is asked for and the model has none.
+  Matrix Compute(const std::vector<int> &sources, const std::vector<int> &targets, Method method = Method::Auto);
+
+private:
+  // Search state of one worker.
+  struct Worker
+  {
+    SearchWorkspace workspace;
+    OpenList open_list;
+    std::vector<float> distances;
+    std::vector<std::pair<int, float>> settled;
+  };
+
+  void ComputeDijkstra(const std::vector<int> &sources, const std::vector<int> &targets, Matrix &matrix);
+  void ComputeHierarchy(const std::vector<int> &sources, const std::vector<int> &targets, Matrix &matrix);
+  // Settles the upward search space of node into worker.settled as (node, distance) pairs.
+  void UpwardSearch(int node, Worker &worker) const;
+
+  const RouteModel &m_Model;
+  ThreadPool m_Pool;
+  std::vector<std::unique_ptr<Worker>> m_Workers;
+};
+
+#endif
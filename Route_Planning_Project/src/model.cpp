@@ -1,51 +1,84 @@
 #include "model.h"
+#include "model_builder.h"
+#include "model_cache.h"
+#include "mapped_file.h"
+#include "osm_stream_handler.h"
+#include "parallel_for.h"
 #include "pugixml.hpp"
+#include <fstream>
 #include <iostream>
 #include <string_view>
 #include <cmath>
 #include <algorithm>
-#include <assert.h>
+#include <array>
+#include <optional>
 
-static Model::Road::Type String2RoadType(std::string_view type)
+Model::Model( const std::vector<std::byte> &xml, const ModelOptions &options )
 {
-    if( type == "motorway" )        return Model::Road::Motorway;
-    if( type == "trunk" )           return Model::Road::Trunk;
-    if( type == "primary" )         return Model::Road::Primary;
-    if( type == "secondary" )       return Model::Road::Secondary;    
-    if( type == "tertiary" )        return Model::Road::Tertiary;
-    if( type == "residential" )     return Model::Road::Residential;
-    if( type == "living_street" )   return Model::Road::Residential;    
-    if( type == "service" )         return Model::Road::Service;
-    if( type == "unclassified" )    return Model::Road::Unclassified;
-    if( type == "footway" )         return Model::Road::Footway;
-    if( type == "bridleway" )       return Model::Road::Footway;
-    if( type == "steps" )           return Model::Road::Footway;
-    if( type == "path" )            return Model::Road::Footway;
-    if( type == "pedestrian" )      return Model::Road::Footway;    
-    return Model::Road::Invalid;    
+    const auto checksum = options.cache_path.empty() ? 0 : OsmChecksum(xml.data(), xml.size());
+    if( options.threads != 1 )
+        Build(options, checksum, [&]{ LoadParallel((const char*)xml.data(), xml.size(), options.threads); });
+    else
+        Build(options, checksum, [&]{ LoadData(xml); });
 }
 
-static Model::Landuse::Type String2LanduseType(std::string_view type)
+Model::Model( const std::string &osm_file, const ModelOptions &options )
 {
-    if( type == "commercial" )      return Model::Landuse::Commercial;
-    if( type == "construction" )    return Model::Landuse::Construction;
-    if( type == "grass" )           return Model::Landuse::Grass;
-    if( type == "forest" )          return Model::Landuse::Forest;
-    if( type == "industrial" )      return Model::Landuse::Industrial;
-    if( type == "railway" )         return Model::Landuse::Railway;
-    if( type == "residential" )     return Model::Landuse::Residential;    
-    return Model::Landuse::Invalid;
+    if( options.threads != 1 ) {
+        MappedFile file{osm_file};
+        if( !file.IsOpen() )
+            throw std::logic_error("failed to open the osm file");
+        const auto checksum = options.cache_path.empty() ? 0 : OsmChecksum(file.Data(), file.Size());
+        Build(options, checksum, [&]{ LoadParallel((const char*)file.Data(), file.Size(), options.threads); });
+        return;
+    }
+    
+    std::ifstream is{osm_file, std::ios::binary};
+    if( !is )
+        throw std::logic_error("failed to open the osm file");
+    
+    std::uint64_t checksum = 0;
+    if( !options.cache_path.empty() ) {
+        checksum = kOsmChecksumSeed;
+        std::vector<char> chunk(64 * 1024);
+        while( is ) {
+            is.read(chunk.data(), chunk.size());
+            checksum = OsmChecksum((const std::byte*)chunk.data(), (std::size_t)is.gcount(), checksum);
+        }
+        is.clear();
+        is.seekg(0);
+    }
+    Build(options, checksum, [&]{ LoadStream(is); });
 }
 
-Model::Model( const std::vector<std::byte> &xml )
+void Model::Build( const ModelOptions &options, std::uint64_t checksum, const std::function<void()> &load )
 {
-    LoadData(xml);
+    // A cache holds the nodes in the order it was built with.
+    if( options.reorder_nodes ) {
+        const char order[] = "hilbert";
+        checksum = OsmChecksum((const std::byte*)order, sizeof(order), checksum);
+    }
+    // And the coordinates projected with the tolerance it was built with.
+    if( options.projection_tolerance > 0. )
+        checksum = OsmChecksum((const std::byte*)&options.projection_tolerance, sizeof(double), checksum);
+    const auto use_cache = !options.cache_path.empty();
+    if( use_cache && LoadCache(options.cache_path, checksum) ) {
+        m_LoadedFromCache = true;
+        return;
+    }
+
+    load();
 
-    AdjustCoordinates();
+    AdjustCoordinates(options);
+    if( options.reorder_nodes )
+        ReorderNodes();
 
     std::sort(m_Roads.begin(), m_Roads.end(), [](const auto &_1st, const auto &_2nd){
         return (int)_1st.type < (int)_2nd.type; 
     });
+
+    if( use_cache )
+        SaveCache(options.cache_path, checksum);
 }
 
 void Model::LoadData(const std::vector<std::byte> &xml)
@@ -56,198 +89,292 @@ void Model::LoadData(const std::vector<std::byte> &xml)
     if( !doc.load_buffer(xml.data(), xml.size()) )
         throw std::logic_error("failed to parse the xml file");
     
+    Builder builder{*this};
     if( auto bounds = doc.select_nodes("/osm/bounds"); !bounds.empty() ) {
         auto node = bounds.first().node();
-        m_MinLat = atof(node.attribute("minlat").as_string());
-        m_MaxLat = atof(node.attribute("maxlat").as_string());
-        m_MinLon = atof(node.attribute("minlon").as_string());
-        m_MaxLon = atof(node.attribute("maxlon").as_string());
+        builder.SetBounds(node.attribute("minlat").as_string(), node.attribute("maxlat").as_string(),
+                          node.attribute("minlon").as_string(), node.attribute("maxlon").as_string());
     }
     else 
         throw std::logic_error("map's bounds are not defined");
 
-    std::unordered_map<std::string, int> node_id_to_num;
-    for( const auto &node: doc.select_nodes("/osm/node") ) {
-        node_id_to_num[node.node().attribute("id").as_string()] = (int)m_Nodes.size();
-        m_Nodes.emplace_back();        
-        m_Nodes.back().y = atof(node.node().attribute("lat").as_string());
-        m_Nodes.back().x = atof(node.node().attribute("lon").as_string());
-    }
+    for( const auto &node: doc.select_nodes("/osm/node") )
+        builder.AddNode(node.node().attribute("id").as_string(),
+                        node.node().attribute("lat").as_string(),
+                        node.node().attribute("lon").as_string());
 
-    std::unordered_map<std::string, int> way_id_to_num;    
     for( const auto &way: doc.select_nodes("/osm/way") ) {
         auto node = way.node();
-        
-        const auto way_num = (int)m_Ways.size();
-        way_id_to_num[node.attribute("id").as_string()] = way_num;
-        m_Ways.emplace_back();
-        auto &new_way = m_Ways.back();
-        
+        builder.BeginWay(node.attribute("id").as_string());
         for( auto child: node.children() ) {
             auto name = std::string_view{child.name()}; 
-            if( name == "nd" ) {
-                auto ref = child.attribute("ref").as_string();
-                if( auto it = node_id_to_num.find(ref); it != end(node_id_to_num) )
-                    new_way.nodes.emplace_back(it->second);
-            }
-            else if( name == "tag" ) {
-                auto category = std::string_view{child.attribute("k").as_string()};
-                auto type = std::string_view{child.attribute("v").as_string()};
-                if( category == "highway" ) {
-                    if( auto road_type = String2RoadType(type); road_type != Road::Invalid ) {
-                        m_Roads.emplace_back();
-                        m_Roads.back().way = way_num;
-                        m_Roads.back().type = road_type;
-                    }
-                }
-                if( category == "railway" ) {
-                    m_Railways.emplace_back();
-                    m_Railways.back().way = way_num;
-                }                
-                else if( category == "building" ) {
-                    m_Buildings.emplace_back();
-                    m_Buildings.back().outer = {way_num};
-                }
-                else if( category == "leisure" ||
-                        (category == "natural" && (type == "wood"  || type == "tree_row" || type == "scrub" || type == "grassland")) ||
-                        (category == "landcover" && type == "grass" ) ) {
-                    m_Leisures.emplace_back();
-                    m_Leisures.back().outer = {way_num};
-                }
-                else if( category == "natural" && type == "water" ) {
-                    m_Waters.emplace_back();
-                    m_Waters.back().outer = {way_num};
-                }
-                else if( category == "landuse" ) {
-                    if( auto landuse_type = String2LanduseType(type); landuse_type != Landuse::Invalid ) {
-                        m_Landuses.emplace_back();
-                        m_Landuses.back().outer = {way_num};
-                        m_Landuses.back().type = landuse_type;
-                    }                    
-                }
-            }
+            if( name == "nd" )
+                builder.AddWayNode(child.attribute("ref").as_string());
+            else if( name == "tag" )
+                builder.AddWayTag(child.attribute("k").as_string(), child.attribute("v").as_string());
         }
     }
     
     for( const auto &relation: doc.select_nodes("/osm/relation") ) {
-        auto node = relation.node();
-        auto noode_id = std::string_view{node.attribute("id").as_string()};
-        std::vector<int> outer, inner;
-        auto commit = [&](Multipolygon &mp) {
-            mp.outer = std::move(outer);
-            mp.inner = std::move(inner);
-        };
-        for( auto child: node.children() ) {
+        builder.BeginRelation();
+        for( auto child: relation.node().children() ) {
+            if( builder.RelationDone() )
+                break;
             auto name = std::string_view{child.name()}; 
-            if( name == "member" ) {
-                if( std::string_view{child.attribute("type").as_string()} == "way" ) {
-                    if( !way_id_to_num.count(child.attribute("ref").as_string()) )
-                        continue;
-                    auto way_num = way_id_to_num[child.attribute("ref").as_string()];
-                    if( std::string_view{child.attribute("role").as_string()} == "outer" )
-                        outer.emplace_back(way_num);
-                    else
-                        inner.emplace_back(way_num);
-                }
-            }
-            else if( name == "tag" ) { 
-                auto category = std::string_view{child.attribute("k").as_string()};
-                auto type = std::string_view{child.attribute("v").as_string()};
-                if( category == "building" ) {
-                    commit( m_Buildings.emplace_back() );
-                    break;
-                }
-                if( category == "natural" && type == "water" ) {
-                    commit( m_Waters.emplace_back() );
-                    BuildRings(m_Waters.back());
-                    break;
-                }
-                if( category == "landuse" ) {
-                    if( auto landuse_type = String2LanduseType(type); landuse_type != Landuse::Invalid ) {
-                        commit( m_Landuses.emplace_back() );
-                        m_Landuses.back().type = landuse_type;
-                        BuildRings(m_Landuses.back());
-                    }
-                    break;
-                }
-            }
+            if( name == "member" )
+                builder.AddRelationMember(child.attribute("type").as_string(),
+                                          child.attribute("ref").as_string(),
+                                          child.attribute("role").as_string());
+            else if( name == "tag" )
+                builder.AddRelationTag(child.attribute("k").as_string(), child.attribute("v").as_string());
         }
     }
 }
 
-void Model::AdjustCoordinates()
+void Model::LoadStream(std::istream &is)
+{
+    Builder builder{*this};
+    OsmStreamHandler handler{builder};
+    XmlStreamParser parser{handler};
+    
+    std::vector<char> chunk(64 * 1024);
+    while( is ) {
+        is.read(chunk.data(), chunk.size());
+        parser.Feed(chunk.data(), (std::size_t)is.gcount());
+    }
+    if( is.bad() )
+        throw std::logic_error("failed to read the osm file");
+    parser.Finish();
+    if( !handler.HasRoot() || handler.Depth() != 0 )
+        throw std::logic_error("failed to parse the xml file");
+    if( !handler.HasBounds() )
+        throw std::logic_error("map's bounds are not defined");
+}
+
+namespace {
+
+const auto pi = 3.14159265358979323846264338327950288;
+const auto deg_to_rad = 2. * pi / 360.;
+const auto earth_radius = 6378137.;
+
+double Lat2Ym(double lat) { return log(tan(lat * deg_to_rad / 2 +  pi/4)) / 2 * earth_radius; }
+double Lon2Xm(double lon) { return lon * deg_to_rad / 2 * earth_radius; }
+
+// Lat2Ym as a degree 5 Taylor polynomial around the middle of each of a number of equally wide
+// latitude bands. The derivatives of log(tan(phi / 2 + pi/4)) are sec(phi) times a polynomial in
+// tan(phi), which bounds the error of a band by its sixth derivative at the band's pole-most
+// latitude.
+class SeriesProjection
+{
+public:
+    // Bands covering [min_lat, max_lat], narrow enough to keep within tolerance meters, or none
+    // when that would take too many of them or the latitudes come close to a pole.
+    SeriesProjection( double min_lat, double max_lat, double tolerance ) {
+        const double max_abs = std::max(std::abs(min_lat), std::abs(max_lat));
+        if( max_abs > kMaxLatitude )
+            return;
+        const double t = tan(max_abs * deg_to_rad), t2 = t * t;
+        const double sixth = t / cos(max_abs * deg_to_rad) * (120 * t2 * t2 + 180 * t2 + 61);
+        // Half a band in radians; its terms beyond the fifth sum to at most sixth * h^6 / 6!.
+        const double h = std::pow(tolerance / (earth_radius / 2) * 720 / std::max(sixth, 1.), 1. / 6);
+        // Bands split the range evenly, so they stay within it and the bound holds.
+        const double bands = std::max(std::ceil((max_lat - min_lat) / (2 * h / deg_to_rad)), 1.);
+        if( !(bands <= kMaxBands) )
+            return;
+        m_First = min_lat;
+        m_Width = max_lat > min_lat ? (max_lat - min_lat) / bands : 1.;
+        m_Bands.resize(bands);
+        for( std::size_t i = 0; i < m_Bands.size(); ++i ) {
+            const double center = m_First + (i + 0.5) * m_Width, phi = center * deg_to_rad;
+            const double s = 1 / cos(phi), t = tan(phi), t2 = t * t, scale = earth_radius / 2;
+            m_Bands[i] = {Lat2Ym(center),
+                          scale * s,
+                          scale * s * t / 2,
+                          scale * s * (2 * t2 + 1) / 6,
+                          scale * s * t * (6 * t2 + 5) / 24,
+                          scale * s * (24 * t2 * t2 + 28 * t2 + 5) / 120};
+        }
+    }
+    
+    bool Usable() const noexcept { return !m_Bands.empty(); }
+    
+    double operator()(double lat) const noexcept {
+        const auto band = std::min((std::size_t)std::max((lat - m_First) / m_Width, 0.), m_Bands.size() - 1);
+        const auto &c = m_Bands[band];
+        const double d = (lat - (m_First + (band + 0.5) * m_Width)) * deg_to_rad;
+        return c[0] + d * (c[1] + d * (c[2] + d * (c[3] + d * (c[4] + d * c[5]))));
+    }
+    
+private:
+    static constexpr double kMaxBands = 1 << 16;
+    static constexpr double kMaxLatitude = 89.;
+    double m_First = 0.;
+    double m_Width = 0.;
+    std::vector<std::array<double, 6>> m_Bands;
+};
+
+}
+
+void Model::AdjustCoordinates(const ModelOptions &options)
 {    
-    const auto pi = 3.14159265358979323846264338327950288;
-    const auto deg_to_rad = 2. * pi / 360.;
-    const auto earth_radius = 6378137.;
-    const auto lat2ym = [&](double lat) { return log(tan(lat * deg_to_rad / 2 +  pi/4)) / 2 * earth_radius; };
-    const auto lon2xm = [&](double lon) { return lon * deg_to_rad / 2 * earth_radius; };     
-    const auto dx = lon2xm(m_MaxLon) - lon2xm(m_MinLon);
-    const auto dy = lat2ym(m_MaxLat) - lat2ym(m_MinLat);
-    const auto min_y = lat2ym(m_MinLat);
-    const auto min_x = lon2xm(m_MinLon);
+    const auto dx = Lon2Xm(m_MaxLon) - Lon2Xm(m_MinLon);
+    const auto dy = Lat2Ym(m_MaxLat) - Lat2Ym(m_MinLat);
+    const auto min_y = Lat2Ym(m_MinLat);
+    const auto min_x = Lon2Xm(m_MinLon);
     m_MetricScale = std::min(dx, dy);
-    for( auto &node: m_Nodes ) {
-        node.x = (lon2xm(node.x) - min_x) / m_MetricScale;
-        node.y = (lat2ym(node.y) - min_y) / m_MetricScale;        
+    
+    std::optional<SeriesProjection> series;
+    if( options.projection_tolerance > 0. ) {
+        // The series covers every node's latitude: nodes may lie outside the bounds, on ways
+        // that cross them.
+        double min_lat = m_MinLat, max_lat = m_MaxLat;
+        for( const auto &node: m_Nodes ) {
+            min_lat = std::min(min_lat, node.y);
+            max_lat = std::max(max_lat, node.y);
+        }
+        if( series.emplace(min_lat, max_lat, options.projection_tolerance); !series->Usable() )
+            series.reset();
     }
+    
+    const auto project = [&]( Node *nodes, std::size_t count, auto &&lat2ym ) {
+        for( std::size_t i = 0; i < count; ++i ) {
+            nodes[i].x = (Lon2Xm(nodes[i].x) - min_x) / m_MetricScale;
+            nodes[i].y = (lat2ym(nodes[i].y) - min_y) / m_MetricScale;
+        }
+    };
+    const std::size_t block = 64 * 1024;
+    const auto threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    ParallelFor((m_Nodes.size() + block - 1) / block, threads, [&]( std::size_t i ) {
+        const auto count = std::min(block, m_Nodes.size() - i * block);
+        if( series )
+            project(m_Nodes.data() + i * block, count, *series);
+        else
+            project(m_Nodes.data() + i * block, count, Lat2Ym);
+    });
 }
 
-static bool TrackRec(const std::vector<int> &open_ways,
-                     const Model::Way *ways,
-                     std::vector<bool> &used,
-                     std::vector<int> &nodes) 
+Model::Location Model::ToLocation(double x, double y) const
 {
-    if( nodes.empty() ) {
-        for( int i = 0; i < open_ways.size(); ++i )
-            if( !used[i] ) {
-                used[i] = true;
-                const auto &way_nodes = ways[open_ways[i]].nodes;
-                nodes = way_nodes;
-                if( TrackRec(open_ways, ways, used, nodes) )
-                    return true;
-                nodes.clear();
-                used[i] = false;
+    const auto ym = y * m_MetricScale + Lat2Ym(m_MinLat);
+    const auto xm = x * m_MetricScale + Lon2Xm(m_MinLon);
+    return {(2 * atan(exp(ym * 2 / earth_radius)) - pi/2) / deg_to_rad, xm * 2 / earth_radius / deg_to_rad};
+}
+
+Model::Node Model::Extent() const
+{
+    return {(Lon2Xm(m_MaxLon) - Lon2Xm(m_MinLon)) / m_MetricScale, (Lat2Ym(m_MaxLat) - Lat2Ym(m_MinLat)) / m_MetricScale};
+}
+
+// Position of cell (x, y) along the Hilbert curve filling a 2^16 x 2^16 grid.
+static std::uint64_t HilbertIndex(std::uint32_t x, std::uint32_t y)
+{
+    std::uint64_t d = 0;
+    for( std::uint32_t s = 1u << 15; s > 0; s /= 2 ) {
+        const std::uint32_t rx = (x & s) ? 1 : 0;
+        const std::uint32_t ry = (y & s) ? 1 : 0;
+        d += std::uint64_t(s) * s * ((3 * rx) ^ ry);
+        // Rotate the quadrant so the curve continues where the previous one ended.
+        if( ry == 0 ) {
+            if( rx == 1 ) {
+                x = s - 1 - (x & (s - 1));
+                y = s - 1 - (y & (s - 1));
             }
-        return false;
+            std::swap(x, y);
+        }
+        x &= s - 1;
+        y &= s - 1;
     }
-    else {
-        const auto head = nodes.front();
-        const auto tail = nodes.back();
-        if( head == tail && nodes.size() > 1 )
-            return true;
-        for( int i = 0; i < open_ways.size(); ++i )
-            if( !used[i] ) {
-                const auto &way_nodes = ways[open_ways[i]].nodes;
-                const auto way_head = way_nodes.front();
-                const auto way_tail = way_nodes.back();
-                if( way_head == tail || way_tail == tail ) {
-                    used[i] = true;
-                    const auto len = nodes.size();
-                    if( way_head == tail ) 
-                        nodes.insert(nodes.end(), way_nodes.begin(), way_nodes.end());
-                    else
-                        nodes.insert(nodes.end(), way_nodes.rbegin(), way_nodes.rend());
-                    if( TrackRec(open_ways, ways, used, nodes) )
-                        return true;
-                    nodes.resize(len);                    
-                    used[i] = false;
-                }
-            }
-        return false;
+    return d;
+}
+
+void Model::ReorderNodes()
+{
+    if( m_Nodes.empty() )
+        return;
+    double min_x = m_Nodes[0].x, max_x = min_x, min_y = m_Nodes[0].y, max_y = min_y;
+    for( auto &node: m_Nodes ) {
+        min_x = std::min(min_x, node.x);
+        max_x = std::max(max_x, node.x);
+        min_y = std::min(min_y, node.y);
+        max_y = std::max(max_y, node.y);
+    }
+    const double cells = 65535.;
+    const double extent = std::max({max_x - min_x, max_y - min_y, 1e-12});
+    
+    std::vector<std::pair<std::uint64_t, int>> keys(m_Nodes.size());
+    for( int i = 0; i < (int)m_Nodes.size(); ++i ) {
+        const auto x = (std::uint32_t)((m_Nodes[i].x - min_x) / extent * cells);
+        const auto y = (std::uint32_t)((m_Nodes[i].y - min_y) / extent * cells);
+        keys[i] = {HilbertIndex(x, y), i};
+    }
+    std::sort(keys.begin(), keys.end());
+    
+    std::vector<Node> nodes(m_Nodes.size());
+    std::vector<int> new_index(m_Nodes.size());
+    for( int i = 0; i < (int)keys.size(); ++i ) {
+        nodes[i] = m_Nodes[keys[i].second];
+        new_index[keys[i].second] = i;
     }
+    m_Nodes = std::move(nodes);
+    for( auto &way: m_Ways )
+        for( auto &node: way.nodes )
+            node = new_index[node];
 }
 
-static std::vector<int> Track(std::vector<int> &open_ways, const Model::Way *ways)
+// Joins open ways into closed rings, each the node lists of its ways end to end. A ring starts with
+// the first unused way and follows, from its tail, the first unused way with an end there, reversed
+// if need be, until it is back at its head. Ends are found through a hash map, so stitching takes
+// time linear in the number of nodes. A chain that stops without closing is dropped with its ways:
+// where at most two ways meet at a node, it was the only way through them.
+static std::vector<std::vector<int>> StitchRings(const std::vector<int> &open_ways, const std::vector<Model::Way> &ways)
 {
-    assert( !open_ways.empty() );
+    struct End {
+        std::vector<int> ways; // Indices into open_ways, ascending.
+        std::size_t skip = 0;  // ways[0, skip) are used.
+    };
+    std::unordered_map<int, End> ends;
+    ends.reserve(2 * open_ways.size());
     std::vector<bool> used(open_ways.size(), false);
-    std::vector<int> nodes;    
-    if( TrackRec(open_ways, ways, used, nodes) )
-        for( int i = 0; i < open_ways.size(); ++i )
-            if( used[i] )
-                open_ways[i] = -1;
-    return nodes;
+    for( int i = 0; i < (int)open_ways.size(); ++i ) {
+        const auto &nodes = ways[open_ways[i]].nodes;
+        if( nodes.empty() ) {
+            used[i] = true;
+            continue;
+        }
+        ends[nodes.front()].ways.emplace_back(i);
+        ends[nodes.back()].ways.emplace_back(i);
+    }
+    
+    auto next = [&]( int node ) {
+        auto &end = ends[node];
+        while( end.skip < end.ways.size() && used[end.ways[end.skip]] )
+            ++end.skip;
+        for( auto i = end.skip; i < end.ways.size(); ++i )
+            if( !used[end.ways[i]] )
+                return end.ways[i];
+        return -1;
+    };
+    
+    std::vector<std::vector<int>> rings;
+    for( int first = 0; first < (int)open_ways.size(); ++first ) {
+        if( used[first] )
+            continue;
+        used[first] = true;
+        auto nodes = ways[open_ways[first]].nodes;
+        for( int i = next(nodes.back()); i >= 0; i = next(nodes.back()) ) {
+            used[i] = true;
+            const auto &way_nodes = ways[open_ways[i]].nodes;
+            if( way_nodes.front() == nodes.back() )
+                nodes.insert(nodes.end(), way_nodes.begin(), way_nodes.end());
+            else
+                nodes.insert(nodes.end(), way_nodes.rbegin(), way_nodes.rend());
+            if( nodes.front() == nodes.back() ) {
+                rings.emplace_back(std::move(nodes));
+                break;
+            }
+        }
+    }
+    return rings;
 }
 
 void Model::BuildRings( Multipolygon &mp )
@@ -257,22 +384,14 @@ void Model::BuildRings( Multipolygon &mp )
     };
 
     auto process = [&]( std::vector<int> &ways_nums ) {
-        auto ways = m_Ways.data();
         std::vector<int> closed, open;
-        
         for( auto &way_num: ways_nums )
-            (is_closed(ways[way_num]) ? closed : open).emplace_back(way_num);  
+            (is_closed(m_Ways[way_num]) ? closed : open).emplace_back(way_num);  
         
-        while( !open.empty() ) {            
-            auto new_nodes = Track(open, ways);
-            if( new_nodes.empty() )
-                break;
-            open.erase(std::remove_if(open.begin(), open.end(), [](auto v){return v < 0;}), open.end() );
+        for( auto &ring: StitchRings(open, m_Ways) ) {
             closed.emplace_back( (int)m_Ways.size() );
-            Model::Way new_way;
-            new_way.nodes = std::move(new_nodes);
-            m_Ways.emplace_back(new_way);
-        }        
+            m_Ways.emplace_back().nodes = std::move(ring);
+        }
         std::swap(ways_nums, closed);        
     };
 
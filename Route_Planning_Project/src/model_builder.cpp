@@ -0,0 +1,203 @@
+#include "model_builder.h"
+#include <cstdlib>
+#include <string>
+
+static Model::Road::Type String2RoadType(std::string_view type)
+{
+    if( type == "motorway" )        return Model::Road::Motorway;
+    if( type == "trunk" )           return Model::Road::Trunk;
+    if( type == "primary" )         return Model::Road::Primary;
+    if( type == "secondary" )       return Model::Road::Secondary;    
+    if( type == "tertiary" )        return Model::Road::Tertiary;
+    if( type == "residential" )     return Model::Road::Residential;
+    if( type == "living_street" )   return Model::Road::Residential;    
+    if( type == "service" )         return Model::Road::Service;
+    if( type == "unclassified" )    return Model::Road::Unclassified;
+    if( type == "footway" )         return Model::Road::Footway;
+    if( type == "bridleway" )       return Model::Road::Footway;
+    if( type == "steps" )           return Model::Road::Footway;
+    if( type == "path" )            return Model::Road::Footway;
+    if( type == "pedestrian" )      return Model::Road::Footway;    
+    return Model::Road::Invalid;    
+}
+
+static Model::Landuse::Type String2LanduseType(std::string_view type)
+{
+    if( type == "commercial" )      return Model::Landuse::Commercial;
+    if( type == "construction" )    return Model::Landuse::Construction;
+    if( type == "grass" )           return Model::Landuse::Grass;
+    if( type == "forest" )          return Model::Landuse::Forest;
+    if( type == "industrial" )      return Model::Landuse::Industrial;
+    if( type == "railway" )         return Model::Landuse::Railway;
+    if( type == "residential" )     return Model::Landuse::Residential;    
+    return Model::Landuse::Invalid;
+}
+
+// Same conversion as atof, for values that are not null-terminated.
+double Model::Builder::ParseCoordinate(std::string_view value)
+{
+    char buffer[64];
+    if( value.size() >= sizeof(buffer) )
+        return std::strtod(std::string{value}.c_str(), nullptr);
+    value.copy(buffer, value.size());
+    buffer[value.size()] = '\0';
+    return std::strtod(buffer, nullptr);
+}
+
+Model::Builder::WayTag Model::Builder::ClassifyWayTag(std::string_view category, std::string_view type)
+{
+    if( category == "highway" ) {
+        if( auto road_type = String2RoadType(type); road_type != Road::Invalid )
+            return {WayTag::Road, road_type};
+        return {};
+    }
+    if( category == "railway" )
+        return {WayTag::Railway};
+    if( category == "building" )
+        return {WayTag::Building};
+    if( category == "leisure" ||
+       (category == "natural" && (type == "wood"  || type == "tree_row" || type == "scrub" || type == "grassland")) ||
+       (category == "landcover" && type == "grass" ) )
+        return {WayTag::Leisure};
+    if( category == "natural" && type == "water" )
+        return {WayTag::Water};
+    if( category == "landuse" ) {
+        if( auto landuse_type = String2LanduseType(type); landuse_type != Landuse::Invalid )
+            return {WayTag::Landuse, landuse_type};
+    }
+    return {};
+}
+
+void Model::Builder::SetBounds(std::string_view minlat, std::string_view maxlat, std::string_view minlon, std::string_view maxlon)
+{
+    m_Model.m_MinLat = ParseCoordinate(minlat);
+    m_Model.m_MaxLat = ParseCoordinate(maxlat);
+    m_Model.m_MinLon = ParseCoordinate(minlon);
+    m_Model.m_MaxLon = ParseCoordinate(maxlon);
+}
+
+void Model::Builder::AddNode(std::string_view id, std::string_view lat, std::string_view lon)
+{
+    std::int64_t node_id;
+    OsmIdIndex::Parse(id, node_id);
+    AddNode(node_id, ParseCoordinate(lat), ParseCoordinate(lon));
+}
+
+void Model::Builder::AddNode(std::int64_t id, double lat, double lon)
+{
+    auto &nodes = m_Model.m_Nodes;
+    m_NodeIdToNum.Insert(id, (int)nodes.size());
+    nodes.emplace_back();        
+    nodes.back().y = lat;
+    nodes.back().x = lon;
+}
+
+void Model::Builder::BeginWay(std::string_view id)
+{
+    std::int64_t way_id;
+    OsmIdIndex::Parse(id, way_id);
+    BeginWay(way_id, {});
+}
+
+void Model::Builder::BeginWay(std::int64_t id, std::vector<int> nodes)
+{
+    m_WayNum = (int)m_Model.m_Ways.size();
+    m_WayIdToNum.Insert(id, m_WayNum);
+    m_Model.m_Ways.emplace_back().nodes = std::move(nodes);
+}
+
+void Model::Builder::AddWayNode(std::string_view ref)
+{
+    std::int64_t node_id;
+    if( !OsmIdIndex::Parse(ref, node_id) )
+        return;
+    if( auto node_num = m_NodeIdToNum.Find(node_id); node_num >= 0 )
+        m_Model.m_Ways[m_WayNum].nodes.emplace_back(node_num);
+}
+
+void Model::Builder::AddWayTag(std::string_view category, std::string_view type)
+{
+    AddWayTag(ClassifyWayTag(category, type));
+}
+
+void Model::Builder::AddWayTag(WayTag tag)
+{
+    auto &m = m_Model;
+    const auto way_num = m_WayNum;
+    switch( tag.kind ) {
+        case WayTag::Road:
+            m.m_Roads.emplace_back();
+            m.m_Roads.back().way = way_num;
+            m.m_Roads.back().type = (Road::Type)tag.type;
+            break;
+        case WayTag::Railway:
+            m.m_Railways.emplace_back();
+            m.m_Railways.back().way = way_num;
+            break;
+        case WayTag::Building:
+            m.m_Buildings.emplace_back();
+            m.m_Buildings.back().outer = {way_num};
+            break;
+        case WayTag::Leisure:
+            m.m_Leisures.emplace_back();
+            m.m_Leisures.back().outer = {way_num};
+            break;
+        case WayTag::Water:
+            m.m_Waters.emplace_back();
+            m.m_Waters.back().outer = {way_num};
+            break;
+        case WayTag::Landuse:
+            m.m_Landuses.emplace_back();
+            m.m_Landuses.back().outer = {way_num};
+            m.m_Landuses.back().type = (Landuse::Type)tag.type;
+            break;
+        case WayTag::Ignored:
+            break;
+    }
+}
+
+void Model::Builder::BeginRelation()
+{
+    m_Outer.clear();
+    m_Inner.clear();
+    m_RelationDone = false;
+}
+
+void Model::Builder::AddRelationMember(std::string_view type, std::string_view ref, std::string_view role)
+{
+    std::int64_t way_id;
+    if( m_RelationDone || type != "way" || !OsmIdIndex::Parse(ref, way_id) )
+        return;
+    auto way_num = m_WayIdToNum.Find(way_id);
+    if( way_num < 0 )
+        return;
+    (role == "outer" ? m_Outer : m_Inner).emplace_back(way_num);
+}
+
+void Model::Builder::AddRelationTag(std::string_view category, std::string_view type)
+{
+    if( m_RelationDone )
+        return;
+    auto &m = m_Model;
+    auto commit = [&](Multipolygon &mp) {
+        mp.outer = std::move(m_Outer);
+        mp.inner = std::move(m_Inner);
+    };
+    if( category == "building" ) {
+        commit( m.m_Buildings.emplace_back() );
+        m_RelationDone = true;
+    }
+    else if( category == "natural" && type == "water" ) {
+        commit( m.m_Waters.emplace_back() );
+        m.BuildRings(m.m_Waters.back());
+        m_RelationDone = true;
+    }
+    else if( category == "landuse" ) {
+        if( auto landuse_type = String2LanduseType(type); landuse_type != Landuse::Invalid ) {
+            commit( m.m_Landuses.emplace_back() );
+            m.m_Landuses.back().type = landuse_type;
+            m.BuildRings(m.m_Landuses.back());
+        }
+        m_RelationDone = true;
+    }
+}
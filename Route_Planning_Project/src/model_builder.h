@@ -0,0 +1,53 @@
+#pragma once
+
+#include "model.h"
+#include "osm_id_index.h"
+#include <cstdint>
+#include <string_view>
+
+// Turns OSM elements into Model data. Loaders feed it the elements in document order: nodes first,
+// then ways and relations, as OSM exports guarantee; the parser in use only decides how the
+// elements are read.
+class Model::Builder
+{
+public:
+    // What a way's tag contributes to the model; type is a Road::Type or Landuse::Type.
+    struct WayTag {
+        enum Kind : std::uint8_t { Ignored, Road, Railway, Building, Leisure, Water, Landuse };
+        Kind kind = Ignored;
+        int type = 0;
+    };
+    
+    explicit Builder( Model &model ): m_Model(model) {}
+    
+    void SetBounds(std::string_view minlat, std::string_view maxlat, std::string_view minlon, std::string_view maxlon);
+    void AddNode(std::string_view id, std::string_view lat, std::string_view lon);
+    
+    void BeginWay(std::string_view id);
+    void AddWayNode(std::string_view ref);
+    void AddWayTag(std::string_view category, std::string_view type);
+    
+    void BeginRelation();
+    void AddRelationMember(std::string_view type, std::string_view ref, std::string_view role);
+    void AddRelationTag(std::string_view category, std::string_view type);
+    // Once a relation has been classified by one of its tags, its remaining children are ignored.
+    bool RelationDone() const noexcept { return m_RelationDone; }
+    
+    // Pre-parsed forms of the above, for loaders which parse and classify on worker threads and
+    // commit the results in document order. Invalid ids are OsmIdIndex::kNoId.
+    static double ParseCoordinate(std::string_view value);
+    static WayTag ClassifyWayTag(std::string_view category, std::string_view type);
+    void AddNode(std::int64_t id, double lat, double lon);
+    void BeginWay(std::int64_t id, std::vector<int> nodes);
+    void AddWayTag(WayTag tag);
+    const OsmIdIndex &NodeIds() const noexcept { return m_NodeIdToNum; }
+    
+private:
+    Model &m_Model;
+    OsmIdIndex m_NodeIdToNum;
+    OsmIdIndex m_WayIdToNum;
+    int m_WayNum = -1;
+    std::vector<int> m_Outer;
+    std::vector<int> m_Inner;
+    bool m_RelationDone = false;
+};
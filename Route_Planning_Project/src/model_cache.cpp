@@ -0,0 +1,225 @@
+#include "model_cache.h"
+#include "model.h"
+#include "binary_io.h"
+#include "mapped_file.h"
+#include <cstring>
+#include <type_traits>
+
+namespace {
+
+constexpr char kMagic[8] = {'O', 'S', 'M', 'M', 'O', 'D', 'E', 'L'};
+
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t header_size;
+    std::uint64_t source_checksum;
+    std::uint64_t payload_size;
+    double min_lat;
+    double max_lat;
+    double min_lon;
+    double max_lon;
+    double metric_scale;
+};
+
+static_assert(std::is_trivially_copyable_v<Model::Node> && sizeof(Model::Node) == 2 * sizeof(double),
+              "Model::Node is written to the snapshot as raw x/y pairs");
+
+template <typename MP>
+void PutMultipolygons(BinaryWriter &writer, const std::vector<MP> &mps)
+{
+    std::vector<const std::vector<int>*> outer, inner;
+    for( auto &mp: mps ) {
+        outer.emplace_back(&mp.outer);
+        inner.emplace_back(&mp.inner);
+    }
+    writer.PutCount(mps.size());
+    writer.PutIndexLists(outer);
+    writer.PutIndexLists(inner);
+}
+
+template <typename MP>
+bool GetMultipolygons(BinaryReader &reader, std::vector<MP> &mps)
+{
+    std::size_t count;
+    std::vector<std::vector<int>> outer, inner;
+    if( !reader.GetCount(count) || !reader.GetIndexLists(count, outer) || !reader.GetIndexLists(count, inner) )
+        return false;
+    mps.resize(count);
+    for( std::size_t i = 0; i < count; ++i ) {
+        mps[i].outer = std::move(outer[i]);
+        mps[i].inner = std::move(inner[i]);
+    }
+    return true;
+}
+
+}
+
+std::uint64_t OsmChecksum(const std::byte *data, std::size_t size, std::uint64_t hash) noexcept
+{
+    for( std::size_t i = 0; i < size; ++i ) {
+        hash ^= (std::uint64_t)data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+bool Model::LoadCache(const std::string &path, std::uint64_t source_checksum)
+{
+    MappedFile file{path};
+    if( !file.IsOpen() || file.Size() < sizeof(Header) )
+        return false;
+    
+    Header header;
+    std::memcpy(&header, file.Data(), sizeof(header));
+    if( std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+        header.version != kModelCacheVersion ||
+        header.header_size != sizeof(Header) ||
+        header.source_checksum != source_checksum ||
+        header.payload_size != file.Size() - sizeof(Header) )
+        return false;
+    
+    BinaryReader reader{file.Data() + sizeof(Header), (std::size_t)header.payload_size};
+    std::size_t count;
+    
+    std::vector<Node> nodes;
+    if( !reader.GetCount(count) )
+        return false;
+    nodes.resize(count);
+    if( !reader.Get(nodes.data(), count) )
+        return false;
+
+    std::vector<Way> ways;
+    std::vector<std::vector<int>> way_nodes;
+    if( !reader.GetCount(count) || !reader.GetIndexLists(count, way_nodes) )
+        return false;
+    ways.resize(count);
+    for( std::size_t i = 0; i < count; ++i )
+        ways[i].nodes = std::move(way_nodes[i]);
+
+    std::vector<Road> roads;
+    if( !reader.GetCount(count) )
+        return false;
+    std::vector<int> road_fields(count * 2);
+    if( !reader.Get(road_fields.data(), road_fields.size()) )
+        return false;
+    roads.resize(count);
+    for( std::size_t i = 0; i < count; ++i ) {
+        roads[i].way = road_fields[2 * i];
+        roads[i].type = (Road::Type)road_fields[2 * i + 1];
+    }
+
+    std::vector<int> railway_ways;
+    if( !reader.GetCount(count) )
+        return false;
+    railway_ways.resize(count);
+    if( !reader.Get(railway_ways.data(), count) )
+        return false;
+    std::vector<Railway> railways(count);
+    for( std::size_t i = 0; i < count; ++i )
+        railways[i].way = railway_ways[i];
+
+    std::vector<Building> buildings;
+    std::vector<Leisure> leisures;
+    std::vector<Water> waters;
+    std::vector<Landuse> landuses;
+    if( !GetMultipolygons(reader, buildings) ||
+        !GetMultipolygons(reader, leisures) ||
+        !GetMultipolygons(reader, waters) ||
+        !GetMultipolygons(reader, landuses) )
+        return false;
+    std::vector<int> landuse_types(landuses.size());
+    if( !reader.Get(landuse_types.data(), landuse_types.size()) || !reader.AtEnd() )
+        return false;
+    for( std::size_t i = 0; i < landuses.size(); ++i )
+        landuses[i].type = (Landuse::Type)landuse_types[i];
+
+    const auto node_count = (int)nodes.size();
+    const auto way_count = (int)ways.size();
+    auto valid_way = [&](int way){ return way >= 0 && way < way_count; };
+    for( auto &way: ways )
+        for( auto node: way.nodes )
+            if( node < 0 || node >= node_count )
+                return false;
+    for( auto &road: roads )
+        if( !valid_way(road.way) )
+            return false;
+    for( auto &railway: railways )
+        if( !valid_way(railway.way) )
+            return false;
+    auto valid_mps = [&](const auto &mps) {
+        for( auto &mp: mps ) {
+            for( auto way: mp.outer ) if( !valid_way(way) ) return false;
+            for( auto way: mp.inner ) if( !valid_way(way) ) return false;
+        }
+        return true;
+    };
+    if( !valid_mps(buildings) || !valid_mps(leisures) || !valid_mps(waters) || !valid_mps(landuses) )
+        return false;
+    
+    m_Nodes = std::move(nodes);
+    m_Ways = std::move(ways);
+    m_Roads = std::move(roads);
+    m_Railways = std::move(railways);
+    m_Buildings = std::move(buildings);
+    m_Leisures = std::move(leisures);
+    m_Waters = std::move(waters);
+    m_Landuses = std::move(landuses);
+    m_MinLat = header.min_lat;
+    m_MaxLat = header.max_lat;
+    m_MinLon = header.min_lon;
+    m_MaxLon = header.max_lon;
+    m_MetricScale = header.metric_scale;
+    return true;
+}
+
+bool Model::SaveCache(const std::string &path, std::uint64_t source_checksum) const
+{
+    BinaryWriter writer;
+    
+    writer.PutCount(m_Nodes.size());
+    writer.Put(m_Nodes.data(), m_Nodes.size());
+    
+    std::vector<const std::vector<int>*> way_nodes;
+    for( auto &way: m_Ways )
+        way_nodes.emplace_back(&way.nodes);
+    writer.PutCount(m_Ways.size());
+    writer.PutIndexLists(way_nodes);
+    
+    std::vector<int> road_fields;
+    for( auto &road: m_Roads ) {
+        road_fields.emplace_back(road.way);
+        road_fields.emplace_back((int)road.type);
+    }
+    writer.PutCount(m_Roads.size());
+    writer.Put(road_fields.data(), road_fields.size());
+    
+    std::vector<int> railway_ways;
+    for( auto &railway: m_Railways )
+        railway_ways.emplace_back(railway.way);
+    writer.PutCount(railway_ways.size());
+    writer.Put(railway_ways.data(), railway_ways.size());
+    
+    PutMultipolygons(writer, m_Buildings);
+    PutMultipolygons(writer, m_Leisures);
+    PutMultipolygons(writer, m_Waters);
+    PutMultipolygons(writer, m_Landuses);
+    std::vector<int> landuse_types;
+    for( auto &landuse: m_Landuses )
+        landuse_types.emplace_back((int)landuse.type);
+    writer.Put(landuse_types.data(), landuse_types.size());
+    
+    Header header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kModelCacheVersion;
+    header.header_size = sizeof(Header);
+    header.source_checksum = source_checksum;
+    header.payload_size = writer.Buffer().size();
+    header.min_lat = m_MinLat;
+    header.max_lat = m_MaxLat;
+    header.min_lon = m_MinLon;
+    header.max_lon = m_MaxLon;
+    header.metric_scale = m_MetricScale;
+    
+    return WriteFileAtomically(path, header, writer.Buffer());
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Binary model snapshot layout (native byte order, every section padded to 8 bytes):
+//   header   - magic, format version, checksum of the source OSM data, bounds and metric scale
+//   nodes    - count, then projected x/y pairs
+//   ways     - count, count+1 offsets into the flat node index array, the flat array itself
+//   roads    - count, then way/type pairs
+//   railways - count, then way indices
+//   buildings, leisures, waters, landuses - count, outer rings and inner rings as offset/flat
+//              arrays; landuses are followed by their types
+// Bump kModelCacheVersion whenever any of the above changes, stale snapshots are then reparsed.
+constexpr std::uint32_t kModelCacheVersion = 1;
+
+// 64-bit FNV-1a of the source data, used to detect snapshots made from a different .osm file.
+// Data read in chunks is hashed by passing the previous result as the seed.
+constexpr std::uint64_t kOsmChecksumSeed = 14695981039346656037ull;
+std::uint64_t OsmChecksum(const std::byte *data, std::size_t size, std::uint64_t hash = kOsmChecksumSeed) noexcept;
@@ -0,0 +1,197 @@
+#include "model.h"
+#include "model_builder.h"
+#include "osm_stream_handler.h"
+#include "parallel_for.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace {
+
+// Records the elements of one slice of the document in a form the builder can commit later:
+// ids and coordinates parsed, way tags classified, relations kept verbatim as they are few and
+// their ring building has to run in document order anyway.
+struct ChunkSink {
+    struct Way {
+        std::int64_t id;
+        std::size_t refs_begin;
+        std::size_t tags_begin;
+    };
+    struct RelationChild {
+        enum Kind { Begin, Member, Tag } kind = Begin;
+        std::string a{}, b{}, c{};
+    };
+    
+    bool has_bounds = false;
+    std::string bounds[4];
+    std::vector<std::int64_t> node_ids;
+    std::vector<Model::Node> nodes;
+    std::vector<Way> ways;
+    std::vector<std::int64_t> refs;
+    std::vector<Model::Builder::WayTag> tags;
+    std::vector<RelationChild> relations;
+    
+    // Filled after all nodes are known: node indices of the refs, and per way where they start.
+    std::vector<int> way_nodes;
+    std::vector<std::size_t> way_nodes_begin;
+    
+    void SetBounds(std::string_view minlat, std::string_view maxlat, std::string_view minlon, std::string_view maxlon)
+    {
+        has_bounds = true;
+        bounds[0] = minlat;
+        bounds[1] = maxlat;
+        bounds[2] = minlon;
+        bounds[3] = maxlon;
+    }
+    
+    void AddNode(std::string_view id, std::string_view lat, std::string_view lon)
+    {
+        std::int64_t node_id;
+        OsmIdIndex::Parse(id, node_id);
+        node_ids.emplace_back(node_id);
+        auto &node = nodes.emplace_back();
+        node.y = Model::Builder::ParseCoordinate(lat);
+        node.x = Model::Builder::ParseCoordinate(lon);
+    }
+    
+    void BeginWay(std::string_view id)
+    {
+        std::int64_t way_id;
+        OsmIdIndex::Parse(id, way_id);
+        ways.push_back({way_id, refs.size(), tags.size()});
+    }
+    
+    void AddWayNode(std::string_view ref)
+    {
+        if( std::int64_t node_id; OsmIdIndex::Parse(ref, node_id) )
+            refs.emplace_back(node_id);
+    }
+    
+    void AddWayTag(std::string_view category, std::string_view type)
+    {
+        if( auto tag = Model::Builder::ClassifyWayTag(category, type); tag.kind != Model::Builder::WayTag::Ignored )
+            tags.emplace_back(tag);
+    }
+    
+    void BeginRelation() { relations.push_back({RelationChild::Begin}); }
+    
+    void AddRelationMember(std::string_view type, std::string_view ref, std::string_view role)
+    {
+        relations.push_back({RelationChild::Member, std::string{type}, std::string{ref}, std::string{role}});
+    }
+    
+    void AddRelationTag(std::string_view category, std::string_view type)
+    {
+        relations.push_back({RelationChild::Tag, std::string{category}, std::string{type}});
+    }
+    
+    bool RelationDone() const noexcept { return false; }
+    
+    void ResolveWayNodes(const OsmIdIndex &node_ids)
+    {
+        way_nodes.reserve(refs.size());
+        way_nodes_begin.reserve(ways.size() + 1);
+        for( std::size_t i = 0; i < ways.size(); ++i ) {
+            way_nodes_begin.emplace_back(way_nodes.size());
+            const auto refs_end = i + 1 < ways.size() ? ways[i + 1].refs_begin : refs.size();
+            for( auto r = ways[i].refs_begin; r < refs_end; ++r )
+                if( auto node_num = node_ids.Find(refs[r]); node_num >= 0 )
+                    way_nodes.emplace_back(node_num);
+        }
+        way_nodes_begin.emplace_back(way_nodes.size());
+    }
+};
+
+// Start of the first top-level node, way or relation at or after pos. Markup never appears
+// unescaped inside attribute values, so every '<' found this way starts a tag.
+std::size_t NextTopLevelElement(std::string_view xml, std::size_t pos)
+{
+    auto starts_element = [&](std::size_t at, std::string_view name) {
+        if( xml.compare(at, name.size(), name) != 0 || at + name.size() >= xml.size() )
+            return false;
+        const auto next = xml[at + name.size()];
+        return next == ' ' || next == '\t' || next == '\n' || next == '\r' || next == '/' || next == '>';
+    };
+    while( (pos = xml.find('<', pos)) != std::string_view::npos ) {
+        if( starts_element(pos + 1, "node") || starts_element(pos + 1, "way") || starts_element(pos + 1, "relation") )
+            return pos;
+        ++pos;
+    }
+    return xml.size();
+}
+
+}
+
+void Model::LoadParallel(const char *data, std::size_t size, unsigned threads)
+{
+    if( threads == 0 )
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    
+    // Slice the document on element boundaries, the first slice keeps the prolog and root tag.
+    const auto xml = std::string_view(data, size);
+    std::vector<std::size_t> slices{0};
+    for( unsigned i = 1; i < threads; ++i ) {
+        const auto pos = NextTopLevelElement(xml, std::max(slices.back() + 1, size / threads * i));
+        if( pos >= size )
+            break;
+        slices.emplace_back(pos);
+    }
+    slices.emplace_back(size);
+    const auto chunk_count = slices.size() - 1;
+    
+    std::vector<ChunkSink> chunks(chunk_count);
+    std::vector<int> depths(chunk_count);
+    bool has_root = false;
+    ParallelFor(chunk_count, threads, [&](std::size_t i) {
+        OsmStreamHandler handler{chunks[i], i > 0};
+        XmlStreamParser parser{handler};
+        parser.Feed(data + slices[i], slices[i + 1] - slices[i]);
+        parser.Finish();
+        depths[i] = handler.Depth();
+        if( i == 0 )
+            has_root = handler.HasRoot();
+    });
+    for( std::size_t i = 0; i < chunk_count; ++i )
+        if( depths[i] != (i + 1 == chunk_count ? 0 : 1) )
+            has_root = false;
+    if( !has_root )
+        throw std::logic_error("failed to parse the xml file");
+    
+    Builder builder{*this};
+    auto bounds = std::find_if(chunks.begin(), chunks.end(), [](auto &chunk){ return chunk.has_bounds; });
+    if( bounds == chunks.end() )
+        throw std::logic_error("map's bounds are not defined");
+    builder.SetBounds(bounds->bounds[0], bounds->bounds[1], bounds->bounds[2], bounds->bounds[3]);
+    
+    std::size_t node_count = 0, way_count = 0;
+    for( auto &chunk: chunks ) {
+        node_count += chunk.nodes.size();
+        way_count += chunk.ways.size();
+    }
+    m_Nodes.reserve(node_count);
+    for( auto &chunk: chunks )
+        for( std::size_t i = 0; i < chunk.nodes.size(); ++i )
+            builder.AddNode(chunk.node_ids[i], chunk.nodes[i].y, chunk.nodes[i].x);
+    
+    ParallelFor(chunk_count, threads, [&](std::size_t i) { chunks[i].ResolveWayNodes(builder.NodeIds()); });
+    
+    m_Ways.reserve(way_count);
+    for( auto &chunk: chunks )
+        for( std::size_t i = 0; i < chunk.ways.size(); ++i ) {
+            auto &way = chunk.ways[i];
+            builder.BeginWay(way.id, {chunk.way_nodes.begin() + chunk.way_nodes_begin[i],
+                                      chunk.way_nodes.begin() + chunk.way_nodes_begin[i + 1]});
+            const auto tags_end = i + 1 < chunk.ways.size() ? chunk.ways[i + 1].tags_begin : chunk.tags.size();
+            for( auto t = way.tags_begin; t < tags_end; ++t )
+                builder.AddWayTag(chunk.tags[t]);
+        }
+    
+    for( auto &chunk: chunks )
+        for( auto &child: chunk.relations )
+            switch( child.kind ) {
+                case ChunkSink::RelationChild::Begin:  builder.BeginRelation(); break;
+                case ChunkSink::RelationChild::Member: builder.AddRelationMember(child.a, child.b, child.c); break;
+                case ChunkSink::RelationChild::Tag:    builder.AddRelationTag(child.a, child.b); break;
+            }
+}
@@ -0,0 +1,115 @@
+#ifndef OPEN_LIST_H
+#define OPEN_LIST_H
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+// A* open list: an indexed 4-ary min-heap keyed by node index. Every node is in the heap at
+// most once and its key can be lowered in place, so the heap never holds stale duplicates and
+// its size is bounded by the search frontier.
+class OpenList
+{
+public:
+  // Empties the list for a graph of node_count nodes. Only the slots of nodes still in the
+  // heap are cleared, so this is O(frontier) after the first call.
+  void Reset(std::size_t node_count)
+  {
+    if (m_Positions.size() != node_count)
+      m_Positions.assign(node_count, -1);
+    else
+      for (const auto &entry : m_Heap)
+        m_Positions[entry.node] = -1;
+    m_Heap.clear();
+  }
+
+  bool Empty() const { return m_Heap.empty(); }
+  std::size_t Size() const { return m_Heap.size(); }
+  bool Contains(int node) const { return m_Positions[node] >= 0; }
+  float Key(int node) const { return m_Heap[m_Positions[node]].key; }
+  float TopKey() const { return m_Heap.front().key; }
+
+  void Push(int node, float key)
+  {
+    assert(!Contains(node));
+    m_Heap.push_back({key, node});
+    SiftUp(m_Heap.size() - 1);
+  }
+
+  // Lowers the key of a node that is in the list.
+  void DecreaseKey(int node, float key)
+  {
+    assert(Contains(node) && key <= Key(node));
+    const int position = m_Positions[node];
+    m_Heap[position].key = key;
+    SiftUp(position);
+  }
+
+  // Removes and returns the node with the smallest key.
+  int Pop()
+  {
+    const int node = m_Heap.front().node;
+    m_Positions[node] = -1;
+    const Entry last = m_Heap.back();
+    m_Heap.pop_back();
+    if (!m_Heap.empty())
+      SiftDown(0, last);
+    return node;
+  }
+
+private:
+  static constexpr int kArity = 4;
+
+  struct Entry
+  {
+    float key;
+    int node;
+  };
+
+  void Place(int position, const Entry &entry)
+  {
+    m_Heap[position] = entry;
+    m_Positions[entry.node] = position;
+  }
+
+  void SiftUp(int position)
+  {
+    const Entry entry = m_Heap[position];
+    while (position > 0)
+    {
+      const int parent = (position - 1) / kArity;
+      if (!(entry.key < m_Heap[parent].key))
+        break;
+      Place(position, m_Heap[parent]);
+      position = parent;
+    }
+    Place(position, entry);
+  }
+
+  // Moves entry down from the hole at position to where it belongs.
+  void SiftDown(int position, const Entry &entry)
+  {
+    const int size = m_Heap.size();
+    while (true)
+    {
+      const int first = position * kArity + 1;
+      if (first >= size)
+        break;
+      const int last = std::min(first + kArity, size);
+      int best = first;
+      for (int child = first + 1; child < last; child++)
+        if (m_Heap[child].key < m_Heap[best].key)
+          best = child;
+      if (!(m_Heap[best].key < entry.key))
+        break;
+      Place(position, m_Heap[best]);
+      position = best;
+    }
+    Place(position, entry);
+  }
+
+  std::vector<Entry> m_Heap;
+  std::vector<int> m_Positions; // Heap slot of each node, -1 when not in the list.
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include "osm_id_index.h"
+#include <algorithm>
+#include <charconv>
+
+bool OsmIdIndex::Parse(std::string_view text, std::int64_t &id) noexcept
+{
+    const auto end = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(text.data(), end, id);
+    if( ec == std::errc{} && ptr == end && id != kNoId )
+        return true;
+    id = kNoId;
+    return false;
+}
+
+void OsmIdIndex::Insert(std::int64_t id, int index)
+{
+    if( id == kNoId )
+        return;
+    if( m_Sorted ) {
+        if( m_Ids.empty() || m_Ids.back() < id ) {
+            m_Ids.emplace_back(id);
+            m_Indices.emplace_back(index);
+            return;
+        }
+        auto ids = std::move(m_Ids);
+        auto indices = std::move(m_Indices);
+        m_Sorted = false;
+        m_Count = 0;
+        std::size_t capacity = 16;
+        while( capacity < ids.size() * 4 )
+            capacity *= 2;
+        Rehash(capacity);
+        for( std::size_t i = 0; i < ids.size(); ++i )
+            InsertHashed(ids[i], indices[i]);
+    }
+    InsertHashed(id, index);
+}
+
+int OsmIdIndex::FindSorted(std::int64_t id) const noexcept
+{
+    auto it = std::lower_bound(m_Ids.begin(), m_Ids.end(), id);
+    if( it == m_Ids.end() || *it != id )
+        return -1;
+    return m_Indices[it - m_Ids.begin()];
+}
+
+int OsmIdIndex::FindHashed(std::int64_t id) const noexcept
+{
+    const auto mask = m_Ids.size() - 1;
+    for( auto slot = Hash(id) & mask; m_Indices[slot] >= 0; slot = (slot + 1) & mask )
+        if( m_Ids[slot] == id )
+            return m_Indices[slot];
+    return -1;
+}
+
+void OsmIdIndex::InsertHashed(std::int64_t id, int index)
+{
+    if( (m_Count + 1) * 2 > m_Ids.size() )
+        Rehash(m_Ids.size() * 2);
+    const auto mask = m_Ids.size() - 1;
+    auto slot = Hash(id) & mask;
+    for( ; m_Indices[slot] >= 0; slot = (slot + 1) & mask )
+        if( m_Ids[slot] == id ) {
+            m_Indices[slot] = index;
+            return;
+        }
+    m_Ids[slot] = id;
+    m_Indices[slot] = index;
+    ++m_Count;
+}
+
+// capacity must be a power of two.
+void OsmIdIndex::Rehash(std::size_t capacity)
+{
+    auto ids = std::move(m_Ids);
+    auto indices = std::move(m_Indices);
+    m_Ids.assign(capacity, 0);
+    m_Indices.assign(capacity, -1);
+    m_Count = 0;
+    for( std::size_t i = 0; i < ids.size(); ++i )
+        if( indices[i] >= 0 )
+            InsertHashed(ids[i], indices[i]);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+// Maps 64-bit OSM element ids to model indices. OSM exports list elements sorted by id, so ids
+// are appended to a sorted array and found by binary search; the first out of order id converts
+// the index to an open-addressing hash table, which keeps arbitrary input correct.
+class OsmIdIndex
+{
+public:
+    static constexpr std::int64_t kNoId = std::numeric_limits<std::int64_t>::min();
+    
+    // Parses a decimal id, returns false and sets id to kNoId for anything else.
+    static bool Parse(std::string_view text, std::int64_t &id) noexcept;
+    
+    // Later inserts of the same id replace the earlier index, kNoId is ignored.
+    void Insert(std::int64_t id, int index);
+    // Returns -1 for unknown ids.
+    int Find(std::int64_t id) const noexcept
+    {
+        return m_Sorted ? FindSorted(id) : FindHashed(id);
+    }
+    
+    bool Sorted() const noexcept { return m_Sorted; }
+    std::size_t Size() const noexcept { return m_Sorted ? m_Ids.size() : m_Count; }
+    
+private:
+    int FindSorted(std::int64_t id) const noexcept;
+    int FindHashed(std::int64_t id) const noexcept;
+    void InsertHashed(std::int64_t id, int index);
+    void Rehash(std::size_t capacity);
+    
+    static std::size_t Hash(std::int64_t id) noexcept
+    {
+        auto x = (std::uint64_t)id;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return (std::size_t)(x ^ (x >> 31));
+    }
+    
+    bool m_Sorted = true;
+    // Sorted mode: parallel arrays ordered by id. Hashed mode: slots, an index of -1 marks a free one.
+    std::vector<std::int64_t> m_Ids;
+    std::vector<int> m_Indices;
+    std::size_t m_Count = 0;
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "xml_stream.h"
+#include <stdexcept>
+
+// Forwards the children of /osm to a sink with the interface of Model::Builder while the document
+// is being read. A handler can also start inside the root element, for parsers that are handed a
+// slice of the document holding whole top-level elements.
+template <typename Sink>
+class OsmStreamHandler : public XmlStreamParser::Handler
+{
+public:
+    explicit OsmStreamHandler( Sink &sink, bool inside_root = false ): m_Sink(sink)
+    {
+        if( inside_root ) {
+            m_Depth = 1;
+            m_HasRoot = m_InOsm = true;
+        }
+    }
+    
+    void StartElement(std::string_view name, const std::vector<XmlStreamParser::Attribute> &attributes) override
+    {
+        auto attr = [&](std::string_view attr_name) { return XmlStreamParser::Find(attributes, attr_name); };
+        if( m_Depth == 0 ) {
+            m_HasRoot = true;
+            m_InOsm = name == "osm";
+        }
+        else if( m_Depth == 1 && m_InOsm ) {
+            m_Parent = Parent::None;
+            if( name == "bounds" ) {
+                if( !m_HasBounds )
+                    m_Sink.SetBounds(attr("minlat"), attr("maxlat"), attr("minlon"), attr("maxlon"));
+                m_HasBounds = true;
+            }
+            else if( name == "node" )
+                m_Sink.AddNode(attr("id"), attr("lat"), attr("lon"));
+            else if( name == "way" ) {
+                m_Sink.BeginWay(attr("id"));
+                m_Parent = Parent::Way;
+            }
+            else if( name == "relation" ) {
+                m_Sink.BeginRelation();
+                m_Parent = Parent::Relation;
+            }
+        }
+        else if( m_Depth == 2 && m_Parent == Parent::Way ) {
+            if( name == "nd" )
+                m_Sink.AddWayNode(attr("ref"));
+            else if( name == "tag" )
+                m_Sink.AddWayTag(attr("k"), attr("v"));
+        }
+        else if( m_Depth == 2 && m_Parent == Parent::Relation && !m_Sink.RelationDone() ) {
+            if( name == "member" )
+                m_Sink.AddRelationMember(attr("type"), attr("ref"), attr("role"));
+            else if( name == "tag" )
+                m_Sink.AddRelationTag(attr("k"), attr("v"));
+        }
+        ++m_Depth;
+    }
+    
+    void EndElement(std::string_view) override
+    {
+        if( m_Depth == 0 )
+            throw std::logic_error("failed to parse the xml file");
+        if( --m_Depth == 1 )
+            m_Parent = Parent::None;
+    }
+    
+    int Depth() const noexcept { return m_Depth; }
+    bool HasRoot() const noexcept { return m_HasRoot; }
+    bool HasBounds() const noexcept { return m_HasBounds; }
+    
+private:
+    enum class Parent { None, Way, Relation };
+    
+    Sink &m_Sink;
+    int m_Depth = 0;
+    bool m_HasRoot = false;
+    bool m_InOsm = false;
+    bool m_HasBounds = false;
+    Parent m_Parent = Parent::None;
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+// Runs f(i) for i in [0, count) on up to `threads` threads, rethrowing the first failure.
+template <typename F>
+void ParallelFor(std::size_t count, unsigned threads, F &&f)
+{
+    std::vector<std::exception_ptr> errors(count);
+    std::vector<std::thread> workers;
+    const auto worker_count = std::min<std::size_t>(threads, count);
+    for( std::size_t w = 0; w < worker_count; ++w )
+        workers.emplace_back([&, w]{
+            for( auto i = w; i < count; i += worker_count )
+                try {
+                    f(i);
+                }
+                catch( ... ) {
+                    errors[i] = std::current_exception();
+                }
+        });
+    for( auto &worker: workers )
+        worker.join();
+    for( auto &error: errors )
+        if( error )
+            std::rethrow_exception(error);
+}
@@ -1,160 +1,274 @@
 #include "render.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include "parallel_for.h"
 
 static float RoadMetricWidth(Model::Road::Type type);
 static io2d::rgba_color RoadColor(Model::Road::Type type);
 static io2d::dashes RoadDashes(Model::Road::Type type);
 static io2d::point_2d ToPoint2D( const Model::Node &node ) noexcept; 
 
+// Widest stroke in meters, motorways; features this close to a view are drawn into it.
+static constexpr float kMaxMetricWidth = 6.f;
+
 Render::Render( RouteModel &model ):
     m_Model(model)
 {
     BuildRoadReps();
     BuildLanduseBrushes();
+    BuildWayBoxes();
 }
 
 void Render::Display( io2d::output_surface &surface )
 {
-    m_Scale = static_cast<float>(std::min(surface.dimensions().x(), surface.dimensions().y()));    
-    m_PixelsInMeter = static_cast<float>(m_Scale / m_Model.MetricScale()); 
-    m_Matrix = io2d::matrix_2d::create_scale({m_Scale, -m_Scale}) *
-               io2d::matrix_2d::create_translate({0.f, static_cast<float>(surface.dimensions().y())});
+    const auto begin = std::chrono::steady_clock::now();
+    const auto width = static_cast<float>(surface.dimensions().x());
+    const auto height = static_cast<float>(surface.dimensions().y());
+    const auto scale = std::min(width, height);
+    const auto view = MakeView(scale, 0.f, height / scale, width, height);
+    
+    if( surface.dimensions().x() != m_DisplayWidth || surface.dimensions().y() != m_DisplayHeight ) {
+        m_DisplayPaths = BuildPaths(view);
+        m_DisplayWidth = surface.dimensions().x();
+        m_DisplayHeight = surface.dimensions().y();
+        m_FrameStats.rebuild_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    }
+    Draw(surface, view, m_DisplayPaths);
+    
+    const auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    m_FrameStats.frames++;
+    m_FrameStats.total_ms += ms;
+    m_FrameStats.max_ms = std::max(m_FrameStats.max_ms, ms);
+}
+
+void Render::RenderTile( int z, int x, int y, const std::string &png_file ) const
+{
+    const auto extent = m_Model.Extent();
+    const auto side = std::max(extent.x, extent.y) / (1 << z);
+    const auto view = MakeView(static_cast<float>(kTileSize / side), static_cast<float>(x * side),
+                               static_cast<float>(extent.y - y * side), kTileSize, kTileSize);
+    
+    io2d::image_surface tile{io2d::format::argb32, kTileSize, kTileSize};
+    Draw(tile, view, BuildPaths(view));
+    tile.save(png_file, io2d::image_file_format::png);
+}
+
+std::size_t Render::RenderTiles( const std::string &directory, int max_zoom, unsigned threads ) const
+{
+    if( max_zoom < 0 || max_zoom > MaxTileZoom() )
+        throw std::logic_error("tile zoom levels of this map go from 0 to " + std::to_string(MaxTileZoom()));
+    
+    if( threads == 0 )
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t count = 0;
+    // A level at a time, each column of tiles on one thread, so nothing grows with the number of tiles.
+    for( int z = 0; z <= max_zoom; ++z ) {
+        const auto level = std::filesystem::path{directory} / std::to_string(z);
+        const int side = 1 << z;
+        ParallelFor(side, threads, [&](std::size_t x) {
+            const auto column = level / std::to_string(x);
+            std::filesystem::create_directories(column);
+            for( int y = 0; y < side; ++y )
+                RenderTile(z, static_cast<int>(x), y, (column / (std::to_string(y) + ".png")).string());
+        });
+        count += std::size_t(side) * side;
+    }
+    return count;
+}
+
+int Render::MaxTileZoom() const
+{
+    constexpr double kMinPixelMeters = 0.1;
+    // Past this the float coordinates the paths are built from lose whole pixels anyway.
+    constexpr int kMaxZoom = 16;
+    const auto extent = m_Model.Extent();
+    const auto meters = std::max(extent.x, extent.y) * m_Model.MetricScale();
+    int zoom = 0;
+    while( zoom < kMaxZoom && meters / std::ldexp(double(kTileSize), zoom + 1) >= kMinPixelMeters )
+        ++zoom;
+    return zoom;
+}
+
+Render::View Render::MakeView( float pixels_in_unit, float origin_x, float origin_y, float width, float height ) const
+{
+    View view;
+    view.matrix = io2d::matrix_2d::create_scale({pixels_in_unit, -pixels_in_unit}) *
+                  io2d::matrix_2d::create_translate({-origin_x * pixels_in_unit, origin_y * pixels_in_unit});
+    view.pixels_in_meter = static_cast<float>(pixels_in_unit / m_Model.MetricScale());
     
+    // Strokes reach half their width past a feature's nodes, and never less than a pixel.
+    const auto margin = std::max(kMaxMetricWidth / view.pixels_in_meter, 2.f) / pixels_in_unit;
+    view.visible = {origin_x - margin, origin_y - height / pixels_in_unit - margin,
+                    origin_x + width / pixels_in_unit + margin, origin_y + margin};
+    return view;
+}
+
+Render::Paths Render::BuildPaths( const View &view ) const
+{
+    // Only features that get drawn: those in sight, of a type with a style.
+    Paths paths;
+    auto add_mps = [&](const auto &mps, Paths::List &list, auto styled) {
+        for( std::size_t i = 0; i < mps.size(); ++i )
+            if( styled(mps[i]) && view.visible.Intersects(BoxOf(mps[i])) )
+                list.emplace_back(i, PathFromMP(mps[i], view));
+    };
+    auto any = [](auto &) { return true; };
+    add_mps(m_Model.Landuses(), paths.landuses, [&](auto &landuse) { return m_LanduseBrushes.count(landuse.type) > 0; });
+    add_mps(m_Model.Leisures(), paths.leisures, any);
+    add_mps(m_Model.Waters(), paths.waters, any);
+    add_mps(m_Model.Buildings(), paths.buildings, any);
+    
+    const auto ways = m_Model.Ways().data();
+    auto add_ways = [&](const auto &features, Paths::List &list, auto styled) {
+        for( std::size_t i = 0; i < features.size(); ++i )
+            if( styled(features[i]) && view.visible.Intersects(m_WayBoxes[features[i].way]) )
+                list.emplace_back(i, PathFromWay(ways[features[i].way], view));
+    };
+    add_ways(m_Model.Railways(), paths.railways, any);
+    add_ways(m_Model.Roads(), paths.highways, [&](auto &road) { return m_RoadReps.count(road.type) > 0; });
+    return paths;
+}
+
+template <typename Surface>
+void Render::Draw( Surface &surface, const View &view, const Paths &paths ) const
+{
     surface.paint(m_BackgroundFillBrush);        
-    DrawLanduses(surface);
-    DrawLeisure(surface);
-    DrawWater(surface);    
-    DrawRailways(surface);
-    DrawHighways(surface);    
-    DrawBuildings(surface);  
-    DrawPath(surface);
-    DrawStartPosition(surface);   
-    DrawEndPosition(surface);
+    DrawLanduses(surface, paths);
+    DrawLeisure(surface, paths);
+    DrawWater(surface, paths);    
+    DrawRailways(surface, view, paths);
+    DrawHighways(surface, view, paths);    
+    DrawBuildings(surface, paths);  
+    DrawPath(surface, view);
+    DrawStartPosition(surface, view);   
+    DrawEndPosition(surface, view);
 }
 
-void Render::DrawPath(io2d::output_surface &surface) const{
+template <typename Surface>
+void Render::DrawPath(Surface &surface, const View &view) const{
     io2d::render_props aliased{ io2d::antialias::none };
     io2d::brush foreBrush{ io2d::rgba_color::orange}; 
     float width = 5.0f;
-    surface.stroke(foreBrush, PathLine(), std::nullopt, io2d::stroke_props{width});
+    surface.stroke(foreBrush, PathLine(view), std::nullopt, io2d::stroke_props{width});
 
 }
 
-void Render::DrawEndPosition(io2d::output_surface &surface) const{
+template <typename Surface>
+void Render::DrawEndPosition(Surface &surface, const View &view) const{
     if (m_Model.path.empty()) return;
     io2d::render_props aliased{ io2d::antialias::none };
     io2d::brush foreBrush{ io2d::rgba_color::red };
 
-    auto pb = io2d::path_builder{}; 
-    pb.matrix(m_Matrix);
-
-    pb.new_figure({(float) m_Model.path.back().x, (float) m_Model.path.back().y});
-    float constexpr l_marker = 0.01f;
-    pb.rel_line({l_marker, 0.f});
-    pb.rel_line({0.f, l_marker});
-    pb.rel_line({-l_marker, 0.f});
-    pb.rel_line({0.f, -l_marker});
-    pb.close_figure();
-    
+    auto pb = Marker(m_Model.PathNodes(m_Model.path).back(), view);
     surface.fill(foreBrush, pb);
     surface.stroke(foreBrush, io2d::interpreted_path{pb}, std::nullopt, std::nullopt, std::nullopt, aliased);
 }
 
-void Render::DrawStartPosition(io2d::output_surface &surface) const{
+template <typename Surface>
+void Render::DrawStartPosition(Surface &surface, const View &view) const{
     if (m_Model.path.empty()) return;
 
     io2d::render_props aliased{ io2d::antialias::none };
     io2d::brush foreBrush{ io2d::rgba_color::green };
 
-    auto pb = io2d::path_builder{}; 
-    pb.matrix(m_Matrix);
-
-    pb.new_figure({(float) m_Model.path.front().x, (float) m_Model.path.front().y});
-    float constexpr l_marker = 0.01f;
-    pb.rel_line({l_marker, 0.f});
-    pb.rel_line({0.f, l_marker});
-    pb.rel_line({-l_marker, 0.f});
-    pb.rel_line({0.f, -l_marker});
-    pb.close_figure();
-    
+    auto pb = Marker(m_Model.PathNodes(m_Model.path).front(), view);
     surface.fill(foreBrush, pb);
     surface.stroke(foreBrush, io2d::interpreted_path{pb}, std::nullopt, std::nullopt, std::nullopt, aliased);
 }
 
-void Render::DrawBuildings(io2d::output_surface &surface) const
+template <typename Surface>
+void Render::DrawBuildings(Surface &surface, const Paths &paths) const
 {
-    for( auto &building: m_Model.Buildings() ) {
-        auto path = PathFromMP(building);
+    for( auto &[building, path]: paths.buildings ) {
         surface.fill(m_BuildingFillBrush, path);        
         surface.stroke(m_BuildingOutlineBrush, path, std::nullopt, m_BuildingOutlineStrokeProps);
     }
 }
 
-void Render::DrawLeisure(io2d::output_surface &surface) const
+template <typename Surface>
+void Render::DrawLeisure(Surface &surface, const Paths &paths) const
 {
-    for( auto &leisure: m_Model.Leisures()) {
-        auto path = PathFromMP(leisure);
+    for( auto &[leisure, path]: paths.leisures ) {
         surface.fill(m_LeisureFillBrush, path);        
         surface.stroke(m_LeisureOutlineBrush, path, std::nullopt, m_LeisureOutlineStrokeProps);
     }
 }
 
-void Render::DrawWater(io2d::output_surface &surface) const
+template <typename Surface>
+void Render::DrawWater(Surface &surface, const Paths &paths) const
 {
-    for( auto &water: m_Model.Waters())
-        surface.fill(m_WaterFillBrush, PathFromMP(water));
+    for( auto &[water, path]: paths.waters )
+        surface.fill(m_WaterFillBrush, path);
 }
 
-void Render::DrawLanduses(io2d::output_surface &surface) const
+template <typename Surface>
+void Render::DrawLanduses(Surface &surface, const Paths &paths) const
 {
-    for( auto &landuse: m_Model.Landuses() )
-        if( auto br = m_LanduseBrushes.find(landuse.type); br != m_LanduseBrushes.end() )        
-            surface.fill(br->second, PathFromMP(landuse));
+    auto landuses = m_Model.Landuses().data();
+    for( auto &[landuse, path]: paths.landuses )
+        surface.fill(m_LanduseBrushes.at(landuses[landuse].type), path);
 }
 
-void Render::DrawHighways(io2d::output_surface &surface) const
+template <typename Surface>
+void Render::DrawHighways(Surface &surface, const View &view, const Paths &paths) const
 {
-    auto ways = m_Model.Ways().data();
-    for( auto road: m_Model.Roads() )
-        if( auto rep_it = m_RoadReps.find(road.type); rep_it != m_RoadReps.end() ) {
-            auto &rep = rep_it->second;   
-            auto &way = ways[road.way];
-            auto width = rep.metric_width > 0.f ? (rep.metric_width * m_PixelsInMeter) : 1.f;
-            auto sp = io2d::stroke_props{width, io2d::line_cap::round};
-            surface.stroke(rep.brush, PathFromWay(way), std::nullopt, sp, rep.dashes);        
-        }
+    auto roads = m_Model.Roads().data();
+    for( auto &[road, path]: paths.highways ) {
+        auto &rep = m_RoadReps.at(roads[road].type);   
+        auto width = rep.metric_width > 0.f ? (rep.metric_width * view.pixels_in_meter) : 1.f;
+        auto sp = io2d::stroke_props{width, io2d::line_cap::round};
+        surface.stroke(rep.brush, path, std::nullopt, sp, rep.dashes);        
+    }
 }
 
-void Render::DrawRailways(io2d::output_surface &surface) const
+template <typename Surface>
+void Render::DrawRailways(Surface &surface, const View &view, const Paths &paths) const
 {     
-    auto ways = m_Model.Ways().data();
-    for( auto &railway: m_Model.Railways() ) {
-        auto &way = ways[railway.way];
-        auto path = PathFromWay(way);
-        surface.stroke(m_RailwayStrokeBrush, path, std::nullopt, io2d::stroke_props{m_RailwayOuterWidth * m_PixelsInMeter});
-        surface.stroke(m_RailwayDashBrush, path, std::nullopt, io2d::stroke_props{m_RailwayInnerWidth * m_PixelsInMeter}, m_RailwayDashes);
+    for( auto &[railway, path]: paths.railways ) {
+        surface.stroke(m_RailwayStrokeBrush, path, std::nullopt, io2d::stroke_props{m_RailwayOuterWidth * view.pixels_in_meter});
+        surface.stroke(m_RailwayDashBrush, path, std::nullopt, io2d::stroke_props{m_RailwayInnerWidth * view.pixels_in_meter}, m_RailwayDashes);
     }
 }
 
-io2d::interpreted_path Render::PathLine() const
+io2d::path_builder Render::Marker(const Model::Node &node, const View &view) const
+{
+    auto pb = io2d::path_builder{}; 
+    pb.matrix(view.matrix);
+    pb.new_figure({(float) node.x, (float) node.y});
+    float constexpr l_marker = 0.01f;
+    pb.rel_line({l_marker, 0.f});
+    pb.rel_line({0.f, l_marker});
+    pb.rel_line({-l_marker, 0.f});
+    pb.rel_line({0.f, -l_marker});
+    pb.close_figure();
+    return pb;
+}
+
+io2d::interpreted_path Render::PathLine(const View &view) const
 {    
     if( m_Model.path.empty() )
         return {};
 
-    const auto nodes = m_Model.path;    
+    const auto nodes = m_Model.PathNodes(m_Model.path);
     
     auto pb = io2d::path_builder{};
-    pb.matrix(m_Matrix);
-    pb.new_figure( ToPoint2D( m_Model.path[0]));
+    pb.matrix(view.matrix);
+    pb.new_figure( ToPoint2D( nodes[0]));
 
-    for( int i=1; i< m_Model.path.size();i++ )
-        pb.line( ToPoint2D(m_Model.path[i])); 
+    for( int i=1; i< nodes.size();i++ )
+        pb.line( ToPoint2D(nodes[i])); 
 
       
     return io2d::interpreted_path{pb};
 }
 
-io2d::interpreted_path Render::PathFromWay(const Model::Way &way) const
+io2d::interpreted_path Render::PathFromWay(const Model::Way &way, const View &view) const
 {    
     if( way.nodes.empty() )
         return {};
@@ -162,20 +276,20 @@ io2d::interpreted_path Render::PathFromWay(const Model::Way &way) const
     const auto nodes = m_Model.Nodes().data();    
     
     auto pb = io2d::path_builder{};
-    pb.matrix(m_Matrix);
+    pb.matrix(view.matrix);
     pb.new_figure( ToPoint2D(nodes[way.nodes.front()]) );
     for( auto it = ++way.nodes.begin(); it != std::end(way.nodes); ++it )
         pb.line( ToPoint2D(nodes[*it]) );     
     return io2d::interpreted_path{pb};
 }
 
-io2d::interpreted_path Render::PathFromMP(const Model::Multipolygon &mp) const
+io2d::interpreted_path Render::PathFromMP(const Model::Multipolygon &mp, const View &view) const
 {
     const auto nodes = m_Model.Nodes().data();
     const auto ways = m_Model.Ways().data();
 
     auto pb = io2d::path_builder{};    
-    pb.matrix(m_Matrix);    
+    pb.matrix(view.matrix);    
     
     auto commit = [&](const Model::Way &way) {
         if( way.nodes.empty() )
@@ -194,6 +308,38 @@ io2d::interpreted_path Render::PathFromMP(const Model::Multipolygon &mp) const
     return io2d::interpreted_path{pb};
 }
 
+Render::Box Render::BoxOf(const Model::Multipolygon &mp) const noexcept
+{
+    constexpr auto inf = std::numeric_limits<float>::infinity();
+    Box box{inf, inf, -inf, -inf};
+    auto add = [&](int way_num) {
+        auto &way = m_WayBoxes[way_num];
+        box = {std::min(box.min_x, way.min_x), std::min(box.min_y, way.min_y),
+               std::max(box.max_x, way.max_x), std::max(box.max_y, way.max_y)};
+    };
+    for( auto way_num: mp.outer )
+        add(way_num);
+    for( auto way_num: mp.inner )
+        add(way_num);
+    return box;
+}
+
+void Render::BuildWayBoxes()
+{
+    constexpr auto inf = std::numeric_limits<float>::infinity();
+    const auto nodes = m_Model.Nodes().data();
+    m_WayBoxes.reserve(m_Model.Ways().size());
+    for( auto &way: m_Model.Ways() ) {
+        Box box{inf, inf, -inf, -inf};
+        for( auto node_num: way.nodes ) {
+            const auto p = ToPoint2D(nodes[node_num]);
+            box = {std::min(box.min_x, p.x()), std::min(box.min_y, p.y()),
+                   std::max(box.max_x, p.x()), std::max(box.max_y, p.y())};
+        }
+        m_WayBoxes.push_back(box);
+    }
+}
+
 void Render::BuildRoadReps()
 {
     using R = Model::Road;
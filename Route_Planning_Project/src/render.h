@@ -1,6 +1,10 @@
 #pragma once
 
+#include <cstddef>
+#include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 #include <io2d.h>
 #include "route_model.h"
 
@@ -12,28 +16,81 @@ public:
     Render(RouteModel &model );
     void Display( io2d::output_surface &surface );
     
+    // Side in pixels of the tiles drawn offscreen.
+    static constexpr int kTileSize = 256;
+    // Draws tile (x, y) of zoom level z into an image and saves it as PNG. Level z splits the square
+    // on the map's bounds, anchored at their north-west corner, into 2^z by 2^z tiles; x counts from
+    // the west and y from the north, as web maps number them. Tiles may be drawn on several threads
+    // at once.
+    void RenderTile( int z, int x, int y, const std::string &png_file ) const;
+    // Draws every tile of levels 0 to max_zoom into directory/z/x/y.png on up to `threads` threads,
+    // one per hardware thread when 0. Returns the number of tiles written. Throws std::logic_error
+    // for a max_zoom outside [0, MaxTileZoom()].
+    std::size_t RenderTiles( const std::string &directory, int max_zoom, unsigned threads = 0 ) const;
+    // Deepest zoom level worth drawing for this map: the last one whose pixels still cover 10 cm.
+    int MaxTileZoom() const;
+    
+    // Frames drawn by Display so far and the time they took.
+    struct FrameStats {
+        std::size_t frames = 0;
+        double total_ms = 0.;
+        double max_ms = 0.;
+        double rebuild_ms = 0.; // Part of the total spent building paths after a resize.
+    };
+    const FrameStats &Frames() const noexcept { return m_FrameStats; }
+    
 private:
+    // Axis-aligned box in model coordinates.
+    struct Box {
+        float min_x = 0.f, min_y = 0.f, max_x = 0.f, max_y = 0.f;
+        bool Intersects( const Box &other ) const noexcept {
+            return min_x <= other.max_x && other.min_x <= max_x && min_y <= other.max_y && other.min_y <= max_y;
+        }
+    };
+    // How one drawing maps the model onto its surface. Drawing keeps its state here rather than in
+    // members, so that tiles can be drawn concurrently.
+    struct View {
+        io2d::matrix_2d matrix;
+        float pixels_in_meter = 1.f;
+        Box visible; // Features outside are skipped.
+    };
+    // Paths of the features in sight of a view, with the index of each feature in its model list.
+    // The geometry never changes, so Display keeps them until the surface is resized.
+    struct Paths {
+        using List = std::vector<std::pair<std::size_t, io2d::interpreted_path>>;
+        List landuses, leisures, waters, railways, highways, buildings;
+    };
+    
     void BuildRoadReps();
     void BuildLanduseBrushes();
+    void BuildWayBoxes();
+    View MakeView( float pixels_in_unit, float origin_x, float origin_y, float width, float height ) const;
+    Box BoxOf( const Model::Multipolygon &mp ) const noexcept;
+    Paths BuildPaths( const View &view ) const;
     
-    void DrawBuildings(io2d::output_surface &surface) const;
-    void DrawHighways(io2d::output_surface &surface) const;
-    void DrawRailways(io2d::output_surface &surface) const;
-    void DrawLeisure(io2d::output_surface &surface) const;
-    void DrawWater(io2d::output_surface &surface) const;
-    void DrawLanduses(io2d::output_surface &surface) const;
-    void DrawStartPosition(io2d::output_surface &surface) const;
-    void DrawEndPosition(io2d::output_surface &surface) const;
-    void DrawPath(io2d::output_surface &surface) const;
-    io2d::interpreted_path PathFromWay(const Model::Way &way) const;
-    io2d::interpreted_path PathFromMP(const Model::Multipolygon &mp) const;
-    io2d::interpreted_path PathLine() const;
+    // Surface is io2d::output_surface or io2d::image_surface.
+    template <typename Surface> void Draw(Surface &surface, const View &view, const Paths &paths) const;
+    template <typename Surface> void DrawBuildings(Surface &surface, const Paths &paths) const;
+    template <typename Surface> void DrawHighways(Surface &surface, const View &view, const Paths &paths) const;
+    template <typename Surface> void DrawRailways(Surface &surface, const View &view, const Paths &paths) const;
+    template <typename Surface> void DrawLeisure(Surface &surface, const Paths &paths) const;
+    template <typename Surface> void DrawWater(Surface &surface, const Paths &paths) const;
+    template <typename Surface> void DrawLanduses(Surface &surface, const Paths &paths) const;
+    template <typename Surface> void DrawStartPosition(Surface &surface, const View &view) const;
+    template <typename Surface> void DrawEndPosition(Surface &surface, const View &view) const;
+    template <typename Surface> void DrawPath(Surface &surface, const View &view) const;
+    io2d::interpreted_path PathFromWay(const Model::Way &way, const View &view) const;
+    io2d::interpreted_path PathFromMP(const Model::Multipolygon &mp, const View &view) const;
+    io2d::interpreted_path PathLine(const View &view) const;
+    io2d::path_builder Marker(const Model::Node &node, const View &view) const;
 
     
     RouteModel &m_Model;
-    float m_Scale = 1.f;
-    float m_PixelsInMeter = 1.f;
-    io2d::matrix_2d m_Matrix;
+    std::vector<Box> m_WayBoxes; // Bounds of each way's nodes.
+    Paths m_DisplayPaths;
+    int m_DisplayWidth = -1;
+    int m_DisplayHeight = -1;
+    FrameStats m_FrameStats;
     
     io2d::brush m_BackgroundFillBrush{ io2d::rgba_color{238, 235, 227} };
     
@@ -0,0 +1,152 @@
+#include "route_batch.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+// Id and coordinates of a row, false when it is not a query.
+bool ParseRow(const std::string &line, std::size_t number, std::string &id, float (&coordinates)[4])
+{
+    std::vector<std::string> fields;
+    for (std::size_t begin = 0;; )
+    {
+        const auto end = line.find(',', begin);
+        fields.emplace_back(line.substr(begin, end == std::string::npos ? std::string::npos : end - begin));
+        if (end == std::string::npos)
+            break;
+        begin = end + 1;
+    }
+    if (fields.size() != 4 && fields.size() != 5)
+        return false;
+    const std::size_t first = fields.size() - 4;
+    id = first ? fields[0] : std::to_string(number);
+    for (int i = 0; i < 4; i++)
+    {
+        const char *begin = fields[first + i].c_str();
+        char *end = nullptr;
+        coordinates[i] = std::strtof(begin, &end);
+        while (*end == ' ' || *end == '\t')
+            end++;
+        if (end == begin || *end || !std::isfinite(coordinates[i]))
+            return false;
+    }
+    return true;
+}
+
+bool IsHeader(const std::string &line)
+{
+    const auto last = line.substr(line.rfind(',') + 1);
+    char *end = nullptr;
+    std::strtod(last.c_str(), &end);
+    return end == last.c_str();
+}
+
+void EncodeValue(long value, std::string &encoded)
+{
+    unsigned long bits = value < 0 ? ~((unsigned long)value << 1) : (unsigned long)value << 1;
+    while (bits >= 0x20)
+    {
+        encoded += char((0x20 | (bits & 0x1f)) + 63);
+        bits >>= 5;
+    }
+    encoded += char(bits + 63);
+}
+
+}
+
+void EncodePolyline(const std::vector<Model::Location> &points, std::string &encoded)
+{
+    long lat = 0, lon = 0;
+    for (const auto &point : points)
+    {
+        const long next_lat = std::lround(point.lat * 1e5), next_lon = std::lround(point.lon * 1e5);
+        EncodeValue(next_lat - lat, encoded);
+        EncodeValue(next_lon - lon, encoded);
+        lat = next_lat;
+        lon = next_lon;
+    }
+}
+
+BatchSummary RouteBatch(const RouteModel &model, RouteEngine &engine, std::istream &in, std::ostream &out,
+                        const BatchOptions &options)
+{
+    BatchSummary summary;
+    out << (options.polylines ? "id,distance_m,seconds,nodes,polyline\n" : "id,distance_m,seconds,nodes\n");
+
+    std::vector<std::string> lines, rows;
+    std::vector<char> malformed, unroutable;
+    std::string line, output;
+    bool first_line = true;
+    while (in)
+    {
+        lines.clear();
+        while (lines.size() < options.chunk_rows && std::getline(in, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if (line.empty())
+                continue;
+            if (std::exchange(first_line, false) && IsHeader(line))
+                continue;
+            lines.push_back(std::move(line));
+        }
+
+        rows.assign(lines.size(), {});
+        malformed.assign(lines.size(), false);
+        unroutable.assign(lines.size(), false);
+        const auto first_number = summary.rows + 1;
+        engine.ForEach(lines.size(), [&](std::size_t index, RoutePlanner &planner) {
+            std::string id;
+            float c[4];
+            auto &row = rows[index];
+            if (!ParseRow(lines[index], first_number + index, id, c))
+            {
+                malformed[index] = true;
+                row = std::to_string(first_number + index) + ",,,0" + (options.polylines ? ",\n" : "\n");
+                return;
+            }
+            const auto route = planner.Route(c[0], c[1], c[2], c[3], options.search, options.profile);
+            row = id;
+            char number[64];
+            if (route.path.empty())
+            {
+                unroutable[index] = true;
+                row += ",,,0";
+            }
+            else
+            {
+                std::snprintf(number, sizeof(number), ",%.1f,%.1f,%zu", route.distance, route.seconds, route.path.size());
+                row += number;
+            }
+            if (options.polylines)
+            {
+                std::vector<Model::Location> points;
+                points.reserve(route.path.size());
+                for (int node : route.path)
+                    points.push_back(model.ToLocation(model.SNodes()[node].x, model.SNodes()[node].y));
+                row += ',';
+                EncodePolyline(points, row);
+            }
+            row += '\n';
+        });
+
+        output.clear();
+        for (std::size_t i = 0; i < rows.size(); i++)
+        {
+            output += rows[i];
+            summary.malformed += malformed[i];
+            summary.unroutable += unroutable[i];
+        }
+        out.write(output.data(), output.size());
+        summary.rows += lines.size();
+    }
+    out.flush();
+    return summary;
+}
@@ -0,0 +1,46 @@
+#ifndef ROUTE_BATCH_H
+#define ROUTE_BATCH_H
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include "route_engine.h"
+#include "route_model.h"
+#include "route_planner.h"
+#include "routing_profile.h"
+
+// Offline routing of many queries read from CSV. Rows are read in chunks; the routes of a chunk
+// are searched and formatted on the engine's workers, then written out in row order with one
+// write per chunk, so neither parsing nor output holds up the searches for long.
+//
+// A row is "[id,]start_x,start_y,end_x,end_y" with coordinates in percent of the map's extent, as
+// the interactive program takes them. The id is copied to the output as is; it defaults to the
+// row's number, counting from 1, which rows that cannot be parsed also get. Fields are not
+// quoted. A first row whose last field is not a number is taken for a header and skipped. Each
+// row gets the output row
+//   id,distance_m,seconds,nodes[,polyline]
+// after a header of the same names. The distance and time are empty for rows that cannot be
+// routed or parsed. The polyline is in Google's encoded polyline format, 5 digits of precision.
+struct BatchOptions
+{
+  RoutePlanner::Search search = RoutePlanner::Search::Forward;
+  Profile profile = Profile::Distance;
+  bool polylines = false;
+  std::size_t chunk_rows = 8192;
+};
+
+struct BatchSummary
+{
+  std::size_t rows = 0;       // Data rows read, excluding the header.
+  std::size_t unroutable = 0; // Rows without a route between their points.
+  std::size_t malformed = 0;  // Rows that could not be parsed.
+};
+
+BatchSummary RouteBatch(const RouteModel &model, RouteEngine &engine, std::istream &in, std::ostream &out,
+                        const BatchOptions &options = {});
+
+// Appends the points to encoded in Google's encoded polyline format.
+void EncodePolyline(const std::vector<Model::Location> &points, std::string &encoded);
+
+#endif
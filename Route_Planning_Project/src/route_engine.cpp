@@ -0,0 +1,27 @@
+#include "route_engine.h"
+
+RouteEngine::RouteEngine(const RouteModel &model, unsigned threads) : m_Model(model), m_Pool(threads)
+{
+    for (unsigned worker = 0; worker < m_Pool.Size(); worker++)
+        m_Planners.emplace_back(std::make_unique<RoutePlanner>(m_Model));
+}
+
+std::vector<RoutePlanner::Result> RouteEngine::Route(const std::vector<Query> &queries)
+{
+    std::vector<RoutePlanner::Result> results(queries.size());
+    ForEach(queries.size(), [&](std::size_t index, RoutePlanner &planner) {
+        results[index] = planner.Route(queries[index].start, queries[index].goal, queries[index].search,
+                                       queries[index].profile);
+    });
+    return results;
+}
+
+void RouteEngine::ForEach(std::size_t count, const std::function<void(std::size_t index, RoutePlanner &planner)> &task)
+{
+    m_Pool.ParallelFor(count, [&](std::size_t index, unsigned worker) { task(index, *m_Planners[worker]); });
+}
+
+void RouteEngine::Submit(std::function<void(RoutePlanner &planner)> task)
+{
+    m_Pool.Submit([this, task = std::move(task)](unsigned worker) { task(*m_Planners[worker]); });
+}
@@ -0,0 +1,47 @@
+#ifndef ROUTE_ENGINE_H
+#define ROUTE_ENGINE_H
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include "route_model.h"
+#include "route_planner.h"
+#include "thread_pool.h"
+
+// Runs route queries concurrently on one shared, read-only RouteModel. Each worker thread owns a
+// RoutePlanner, and with it the open list and per-node search arrays, so queries never share
+// mutable state.
+class RouteEngine
+{
+public:
+  struct Query
+  {
+    int start; // Node indices in the model.
+    int goal;
+    RoutePlanner::Search search = RoutePlanner::Search::Forward;
+    Profile profile = Profile::Distance;
+  };
+
+  // threads == 0 uses one worker per hardware thread.
+  explicit RouteEngine(const RouteModel &model, unsigned threads = 0);
+
+  unsigned Threads() const noexcept { return m_Pool.Size(); }
+
+  // Answers every query, results are in query order.
+  std::vector<RoutePlanner::Result> Route(const std::vector<Query> &queries);
+
+  // Runs task(index, planner) for every index in [0, count) across the workers, handing each call
+  // the planner of the worker it runs on. For batch jobs that do more per item than one query.
+  void ForEach(std::size_t count, const std::function<void(std::size_t index, RoutePlanner &planner)> &task);
+
+  // Queues task(planner) to run on the next free worker, with that worker's planner, and returns
+  // at once. For callers that collect results themselves; the task must not throw.
+  void Submit(std::function<void(RoutePlanner &planner)> task);
+
+private:
+  const RouteModel &m_Model;
+  ThreadPool m_Pool;
+  std::vector<std::unique_ptr<RoutePlanner>> m_Planners;
+};
+
+#endif
@@ -1,77 +1,146 @@
 #include "route_model.h"
+#include "contraction_hierarchy.h"
+#include "landmark_table.h"
+#include "model_cache.h"
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
 
-RouteModel::RouteModel(const std::vector<std::byte> &xml) : Model(xml) {
-    // Create RouteModel nodes.
+RouteModel::RouteModel(const std::vector<std::byte> &xml, const ModelOptions &options) : Model(xml, options) {
+    CreateRouteNodes();
+    CreateRoadGraph();
+    CreateRoadNodeIndex();
+}
+
+
+RouteModel::RouteModel(const std::string &osm_file, const ModelOptions &options) : Model(osm_file, options) {
+    CreateRouteNodes();
+    CreateRoadGraph();
+    CreateRoadNodeIndex();
+}
+
+
+RouteModel::~RouteModel() = default;
+
+
+void RouteModel::CreateRouteNodes() {
     int counter = 0;
     for (Model::Node node : this->Nodes()) {
-        m_Nodes.emplace_back(Node(counter, this, node));
+        m_Nodes.emplace_back(Node(counter, node));
         counter++;
     }
-    CreateNodeToRoadHashmap();
 }
 
 
-void RouteModel::CreateNodeToRoadHashmap() {
+void RouteModel::CreateRoadGraph() {
+    // Collect every road segment in both directions, then bucket them by source node.
+    struct Edge {
+        int from, to;
+        float length;
+        RoadType type;
+    };
+    std::vector<Edge> edges;
     for (const Model::Road &road : Roads()) {
-        if (road.type != Model::Road::Type::Footway) {
-            for (int node_idx : Ways()[road.way].nodes) {
-                if (node_to_road.find(node_idx) == node_to_road.end()) {
-                    node_to_road[node_idx] = std::vector<const Model::Road *> ();
-                }
-                node_to_road[node_idx].push_back(&road);
-            }
+        const auto &way_nodes = Ways()[road.way].nodes;
+        for (size_t i = 1; i < way_nodes.size(); i++) {
+            int a = way_nodes[i - 1], b = way_nodes[i];
+            if (a == b)
+                continue;
+            float length = m_Nodes[a].distance(m_Nodes[b]);
+            edges.push_back({a, b, length, road.type});
+            edges.push_back({b, a, length, road.type});
         }
     }
-}
 
+    // Segments shared by several ways of the same type would otherwise show up as parallel edges.
+    std::sort(edges.begin(), edges.end(), [](const Edge &e1, const Edge &e2) {
+        if (e1.from != e2.from)
+            return e1.from < e2.from;
+        return e1.to != e2.to ? e1.to < e2.to : e1.type < e2.type;
+    });
+    edges.erase(std::unique(edges.begin(), edges.end(), [](const Edge &e1, const Edge &e2) {
+        return e1.from == e2.from && e1.to == e2.to && e1.type == e2.type;
+    }), edges.end());
 
-RouteModel::Node *RouteModel::Node::FindNeighbor(std::vector<int> node_indices) {
-    Node *closest_node = nullptr;
-    Node node;
+    m_Graph.offsets.assign(m_Nodes.size() + 1, 0);
+    for (const Edge &edge : edges)
+        m_Graph.offsets[edge.from + 1]++;
+    for (size_t i = 1; i < m_Graph.offsets.size(); i++)
+        m_Graph.offsets[i] += m_Graph.offsets[i - 1];
+    m_Graph.targets.reserve(edges.size());
+    m_Graph.lengths.reserve(edges.size());
+    m_Graph.types.reserve(edges.size());
+    for (const Edge &edge : edges) {
+        m_Graph.targets.push_back(edge.to);
+        m_Graph.lengths.push_back(edge.length);
+        m_Graph.types.push_back(edge.type);
+    }
 
-    for (int node_index : node_indices) {
-        node = parent_model->SNodes()[node_index];
-        if (this->distance(node) != 0 && !node.visited) {
-            if (closest_node == nullptr || this->distance(node) < this->distance(*closest_node)) {
-                closest_node = &parent_model->SNodes()[node_index];
-            }
-        }
+    m_Graph.xs.reserve(m_Nodes.size());
+    m_Graph.ys.reserve(m_Nodes.size());
+    for (const Node &node : m_Nodes) {
+        m_Graph.xs.push_back(node.x);
+        m_Graph.ys.push_back(node.y);
     }
-    return closest_node;
 }
 
 
-void RouteModel::Node::FindNeighbors() {
-    for (auto & road : parent_model->node_to_road[this->index]) {
-        RouteModel::Node *new_neighbor = this->FindNeighbor(parent_model->Ways()[road->way].nodes);
-        if (new_neighbor) {
-            this->neighbors.emplace_back(new_neighbor);
-        }
-    }
+std::uint64_t RouteModel::Graph::Checksum() const {
+    auto hash = OsmChecksum((const std::byte *)offsets.data(), offsets.size() * sizeof(int));
+    hash = OsmChecksum((const std::byte *)targets.data(), targets.size() * sizeof(int), hash);
+    hash = OsmChecksum((const std::byte *)lengths.data(), lengths.size() * sizeof(float), hash);
+    return OsmChecksum((const std::byte *)types.data(), types.size() * sizeof(RoadType), hash);
 }
 
 
-RouteModel::Node &RouteModel::FindClosestNode(float x, float y) {
-    Node input;
-    input.x = x;
-    input.y = y;
+void RouteModel::CreateRoadNodeIndex() {
+    auto index_roads = [this](std::uint32_t roads) {
+        std::vector<int> road_nodes;
+        for (const Model::Road &road : Roads())
+            if (roads & RoadMask(road.type))
+                road_nodes.insert(road_nodes.end(), Ways()[road.way].nodes.begin(), Ways()[road.way].nodes.end());
+        return SpatialIndex{Nodes(), road_nodes};
+    };
+    static_assert(CarProfile::kRoads == DistanceProfile::kRoads && FootProfile::kRoads == BikeProfile::kRoads,
+                  "RoadNodeIndex needs an index per distinct set of roads");
+    m_RoadNodeIndex = index_roads(DistanceProfile::kRoads);
+    m_PathNodeIndex = index_roads(BikeProfile::kRoads);
+}
 
-    float min_dist = std::numeric_limits<float>::max();
-    float dist;
-    int closest_idx;
-
-    for (const Model::Road &road : Roads()) {
-        if (road.type != Model::Road::Type::Footway) {
-            for (int node_idx : Ways()[road.way].nodes) {
-                dist = input.distance(SNodes()[node_idx]);
-                if (dist < min_dist) {
-                    closest_idx = node_idx;
-                    min_dist = dist;
-                }
-            }
-        }
-    }
 
+const RouteModel::Node &RouteModel::FindClosestNode(float x, float y, Profile profile) const {
+    const int closest_idx = RoadNodeIndex(profile).Nearest(x, y);
+    if (closest_idx < 0)
+        throw std::logic_error("the map has no roads to route on");
     return SNodes()[closest_idx];
-}
\ No newline at end of file
+}
+
+
+bool RouteModel::LoadHierarchy(const std::string &path) {
+    auto hierarchy = std::make_unique<ContractionHierarchy>();
+    if (!hierarchy->Load(path, m_Graph))
+        return false;
+    m_Hierarchy = std::move(hierarchy);
+    return true;
+}
+
+
+bool RouteModel::BuildHierarchy(const std::string &path) {
+    m_Hierarchy = std::make_unique<ContractionHierarchy>(m_Graph);
+    return path.empty() || m_Hierarchy->Save(path, m_Graph);
+}
+
+
+bool RouteModel::LoadLandmarks(const std::string &path) {
+    auto landmarks = std::make_unique<LandmarkTable>();
+    if (!landmarks->Load(path, m_Graph))
+        return false;
+    m_Landmarks = std::move(landmarks);
+    return true;
+}
+
+
+bool RouteModel::BuildLandmarks(int count, const std::string &path) {
+    m_Landmarks = std::make_unique<LandmarkTable>(m_Graph, count);
+    return path.empty() || m_Landmarks->Save(path, m_Graph);
+}
@@ -1,46 +1,148 @@
 #ifndef ROUTE_MODEL_H
 #define ROUTE_MODEL_H
 
-#include <limits>
 #include <cmath>
-#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
 #include "model.h"
+#include "routing_profile.h"
+#include "spatial_index.h"
 #include <iostream>
 
+class ContractionHierarchy;
+class LandmarkTable;
+
 class RouteModel : public Model {
 
   public:
+    // A model node with its index; search state lives in RoutePlanner's SearchWorkspace.
     class Node : public Model::Node {
       public:
-        Node * parent = nullptr;
-        float h_value = std::numeric_limits<float>::max();
-        float g_value = 0.0;
-        bool visited = false;
-        std::vector<Node *> neighbors;
-
-        void FindNeighbors();
-        float distance(Node other) const {
-            return std::sqrt(std::pow((x - other.x), 2) + std::pow((y - other.y), 2));
+        float distance(const Node &other) const {
+            const double dx = x - other.x, dy = y - other.y;
+            return std::sqrt(dx * dx + dy * dy);
         }
+        int Index() const { return index; }
 
         Node(){}
-        Node(int idx, RouteModel * search_model, Model::Node node) : Model::Node(node), parent_model(search_model), index(idx) {}
+        Node(int idx, Model::Node node) : Model::Node(node), index(idx) {}
+
+      private:
+        int index = -1;
+    };
+
+    // Road network in compressed sparse row form. The edges leaving node i are
+    // [offsets[i], offsets[i + 1]); each joins two consecutive nodes of a road and stores the
+    // target node, the segment length in model units (multiply by MetricScale() for meters) and
+    // the road type, which routing profiles use to decide access and speed. Every segment is
+    // stored in both directions, once per type of road running along it.
+    //
+    // Node coordinates are kept here too, as separate float arrays in model units, so the
+    // straight-line distances of the search heuristic read 8 contiguous bytes per node instead
+    // of a whole Node.
+    struct Graph {
+        std::vector<int> offsets;
+        std::vector<int> targets;
+        std::vector<float> lengths;
+        std::vector<RoadType> types;
+        std::vector<float> xs;
+        std::vector<float> ys;
+
+        float Distance(int a, int b) const {
+            const float dx = xs[a] - xs[b], dy = ys[a] - ys[b];
+            return std::sqrt(dx * dx + dy * dy);
+        }
+
+        // Fingerprint of the edge arrays, stored with files derived from the graph to detect
+        // stale ones. The coordinates only change along with the lengths.
+        std::uint64_t Checksum() const;
+    };
+
+    // Read-only view of a list of node indices as the nodes they refer to. Nodes are looked up
+    // on access and nothing is copied, so the view must not outlive the model or the list.
+    class NodeView {
+      public:
+        class Iterator {
+          public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = Node;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const Node *;
+            using reference = const Node &;
+
+            Iterator(const std::vector<Node> &nodes, std::vector<int>::const_iterator it) : nodes(&nodes), it(it) {}
+            const Node &operator*() const { return (*nodes)[*it]; }
+            const Node *operator->() const { return &**this; }
+            Iterator &operator++() { ++it; return *this; }
+            Iterator operator++(int) { Iterator old = *this; ++it; return old; }
+            bool operator==(const Iterator &other) const { return it == other.it; }
+            bool operator!=(const Iterator &other) const { return it != other.it; }
+
+          private:
+            const std::vector<Node> *nodes;
+            std::vector<int>::const_iterator it;
+        };
+
+        NodeView(const std::vector<Node> &nodes, const std::vector<int> &indices) : nodes(&nodes), indices(&indices) {}
+        std::size_t size() const { return indices->size(); }
+        bool empty() const { return indices->empty(); }
+        const Node &operator[](std::size_t i) const { return (*nodes)[(*indices)[i]]; }
+        const Node &front() const { return (*nodes)[indices->front()]; }
+        const Node &back() const { return (*nodes)[indices->back()]; }
+        Iterator begin() const { return {*nodes, indices->begin()}; }
+        Iterator end() const { return {*nodes, indices->end()}; }
 
       private:
-        int index;
-        Node * FindNeighbor(std::vector<int> node_indices);
-        RouteModel * parent_model = nullptr;
+        const std::vector<Node> *nodes;
+        const std::vector<int> *indices;
     };
 
-    RouteModel(const std::vector<std::byte> &xml);
-    Node &FindClosestNode(float x, float y);
-    auto &SNodes() { return m_Nodes; }
-    std::vector<Node> path;
+    RouteModel(const std::vector<std::byte> &xml, const ModelOptions &options = {});
+    RouteModel(const std::string &osm_file, const ModelOptions &options = {});
+    ~RouteModel();
+    // Closest node of a road the profile may use; throws when the map has no such road.
+    const Node &FindClosestNode(float x, float y, Profile profile = Profile::Distance) const;
+    auto &SNodes() const { return m_Nodes; }
+    const Graph &RoadGraph() const noexcept { return m_Graph; }
+    // Nodes of the roads a profile may use, for k-nearest and radius queries such as snapping
+    // GPS traces. Non-footway roads for the distance and car profiles.
+    const SpatialIndex &RoadNodeIndex(Profile profile = Profile::Distance) const noexcept {
+        return profile == Profile::Bike || profile == Profile::Foot ? m_PathNodeIndex : m_RoadNodeIndex;
+    }
+    // The nodes that a list of node indices, such as a planned route, refers to.
+    NodeView PathNodes(const std::vector<int> &indices) const { return {m_Nodes, indices}; }
+    NodeView PathNodes(std::vector<int> &&) const = delete;
+    std::vector<int> path; // Node indices of the route to display.
+
+    // Contraction hierarchy of the road graph for RoutePlanner::Search::Hierarchy, nullptr until
+    // one is loaded or built.
+    const ContractionHierarchy *Hierarchy() const noexcept { return m_Hierarchy.get(); }
+    // Loads the hierarchy stored at path. Returns false, keeping the current one, when the file
+    // is missing, damaged or was built for another road graph.
+    bool LoadHierarchy(const std::string &path);
+    // Preprocesses the road graph into a hierarchy and stores it at path unless path is empty.
+    // Returns false when it could not be stored.
+    bool BuildHierarchy(const std::string &path = {});
+
+    // Landmark distance tables for RoutePlanner::Search::Landmarks, nullptr until loaded or built.
+    const LandmarkTable *Landmarks() const noexcept { return m_Landmarks.get(); }
+    // Like LoadHierarchy and BuildHierarchy, for a table of count landmarks.
+    bool LoadLandmarks(const std::string &path);
+    bool BuildLandmarks(int count, const std::string &path = {});
     
   private:
-    void CreateNodeToRoadHashmap();
-    std::unordered_map<int, std::vector<const Model::Road *>> node_to_road;
+    void CreateRouteNodes();
+    void CreateRoadGraph();
+    void CreateRoadNodeIndex();
     std::vector<Node> m_Nodes;
+    Graph m_Graph;
+    SpatialIndex m_RoadNodeIndex; // Roads of DistanceProfile and CarProfile.
+    SpatialIndex m_PathNodeIndex; // Roads of BikeProfile and FootProfile.
+    std::unique_ptr<ContractionHierarchy> m_Hierarchy;
+    std::unique_ptr<LandmarkTable> m_Landmarks;
 
 };
 
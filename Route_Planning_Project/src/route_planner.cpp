@@ -1,94 +1,405 @@
 #include "route_planner.h"
+#include "contraction_hierarchy.h"
+#include "landmark_table.h"
 #include <algorithm>
+#include <chrono>
+#include <limits>
 
-/* This comparator will be used two compare two nodes in the heap */
-bool RoutePlanner::CompareNodes::operator()(RouteModel::Node *node1, RouteModel::Node *node2)
+RoutePlanner::RoutePlanner(const RouteModel &model) : m_Model(model), m_Kernels(GetDistanceKernels())
 {
-    return (node1->g_value + node1->h_value) > (node2->g_value + node2->h_value);
+    const auto &offsets = m_Model.RoadGraph().offsets;
+    int degree = 0;
+    for (std::size_t node = 0; node + 1 < offsets.size(); node++)
+        degree = std::max(degree, offsets[node + 1] - offsets[node]);
+    m_NeighborDistances.resize(degree);
 }
 
-RoutePlanner::RoutePlanner(RouteModel &model, float start_x, float start_y, float end_x, float end_y) : m_Model(model)
+RoutePlanner::Result RoutePlanner::Route(int start, int goal, Search search, Profile profile)
+{
+    const auto begin = std::chrono::steady_clock::now();
+    Result result;
+    if (search == Search::Hierarchy && (!m_Model.Hierarchy() || profile != Profile::Distance))
+        search = Search::Forward;
+    if (search == Search::Hierarchy)
+    {
+        StartHierarchySearch(start, goal);
+        if (HierarchySearch())
+            result.path = ConstructHierarchyPath();
+    }
+    else if (search == Search::Bidirectional)
+    {
+        StartBidirectionalSearch(start, goal, profile);
+        if (BidirectionalSearch())
+            result.path = ConstructBidirectionalPath();
+    }
+    else
+    {
+        StartSearch(start, goal, search == Search::Landmarks, profile);
+        if (AStarSearch())
+            result.path = ConstructFinalPath(m_Goal);
+    }
+    result.distance = CalculateDistance(result.path);
+    result.seconds = CalculateTime(result.path);
+    result.stats = m_Stats;
+    result.stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    return result;
+}
+
+RoutePlanner::Result RoutePlanner::Route(float start_x, float start_y, float end_x, float end_y, Search search,
+                                         Profile profile)
 {
     // Convert inputs to percentage:
     start_x *= 0.01;
     start_y *= 0.01;
     end_x *= 0.01;
     end_y *= 0.01;
-    // Store the nodes you find in the RoutePlanner's start_node and end_node attributes.
-    start_node = &m_Model.FindClosestNode(start_x, start_y);
-    end_node = &m_Model.FindClosestNode(end_x, end_y);
+    return Route(m_Model.FindClosestNode(start_x, start_y, profile).Index(),
+                 m_Model.FindClosestNode(end_x, end_y, profile).Index(), search, profile);
+}
+
+void RoutePlanner::StartSearch(int start, int goal, bool use_landmarks, Profile profile)
+{
+    /* Landmark distances bound routes over the roads they were computed on, so they only help
+       profiles that use the same roads */
+    m_Start = start;
+    m_Goal = goal;
+    m_Profile = profile;
+    m_UseLandmarks = use_landmarks && m_Model.Landmarks() &&
+                     WithProfile(profile, [](auto p) { return decltype(p)::kRoads == DistanceProfile::kRoads; });
+    m_Workspace.Reset(m_Model.SNodes().size());
+    m_OpenList.Reset(m_Model.SNodes().size());
+    m_Stats = {};
+    m_Workspace.Visit(start, -1, 0.0f, CalculateHValue(start));
+    m_OpenList.Push(start, m_Workspace.H(start));
+    m_Stats.pushed++;
 }
 
-float RoutePlanner::CalculateHValue(RouteModel::Node const *node)
+float RoutePlanner::CalculateHValue(int node) const
 {
-    return node->distance(*(end_node));
+    return WithProfile(m_Profile, [&](auto profile) { return CalculateHValue(node, profile); });
 }
 
-void RoutePlanner::AddNeighbors(RouteModel::Node *current_node)
+template <typename P>
+float RoutePlanner::CalculateHValue(int node, P profile) const
 {
-    current_node->FindNeighbors();
-    for (auto *node : current_node->neighbors)
+    return CalculateHValue(node, m_Model.RoadGraph().Distance(node, m_Goal), profile);
+}
+
+template <typename P>
+float RoutePlanner::CalculateHValue(int node, float straight, P) const
+{
+    /* Both distance bounds are consistent, so their maximum is too. Scaled by the profile they
+       bound the cost of the remaining route. */
+    return (m_UseLandmarks ? std::max(straight, m_Model.Landmarks()->LowerBound(node, m_Goal)) : straight) *
+           P::kHeuristicScale;
+}
+
+void RoutePlanner::AddNeighbors(int current_node)
+{
+    WithProfile(m_Profile, [&](auto profile) { AddNeighbors(current_node, profile); });
+}
+
+template <typename P>
+void RoutePlanner::AddNeighbors(int current_node, P profile)
+{
+    /* Neighbors are the open ends of the road segments leaving current_node that the profile
+       allows. The heuristic is consistent, so closed nodes already have their lowest cost. */
+    const auto &graph = m_Model.RoadGraph();
+    const float current_g = m_Workspace.G(current_node);
+    const int first = graph.offsets[current_node], last = graph.offsets[current_node + 1];
+    m_Kernels.gather_distances(graph.xs.data(), graph.ys.data(), graph.targets.data() + first, last - first,
+                               graph.xs[m_Goal], graph.ys[m_Goal], m_NeighborDistances.data());
+    for (int edge = first; edge < last; edge++)
     {
-        node->parent = current_node;
-        node->h_value = CalculateHValue(node);
-        node->g_value = current_node->g_value + node->distance(*current_node);
-        node->visited = true;
-        open_queue.push(node);
+        const int node = graph.targets[edge];
+        if (!P::Allows(graph.types[edge]) || m_Workspace.Closed(node))
+            continue;
+        const float g = current_g + P::Cost(graph.types[edge], graph.lengths[edge]);
+        if (!m_Workspace.Visited(node))
+        {
+            const float h = CalculateHValue(node, m_NeighborDistances[edge - first], profile);
+            m_Workspace.Visit(node, current_node, g, h);
+            m_OpenList.Push(node, g + h);
+            m_Stats.pushed++;
+        }
+        else if (g < m_Workspace.G(node))
+        {
+            const float h = m_Workspace.H(node);
+            m_Workspace.Visit(node, current_node, g, h);
+            m_OpenList.DecreaseKey(node, g + h);
+            m_Stats.decreased++;
+        }
     }
 }
 
-RouteModel::Node *RoutePlanner::NextNode()
+int RoutePlanner::NextNode()
 {
     /* The top node of the heap will have minimum g + h value */
-    RouteModel::Node *firstNode = open_queue.top();
-    open_queue.pop();
-    return firstNode;
+    const int node = m_OpenList.Pop();
+    m_Workspace.Close(node);
+    m_Stats.expanded++;
+    return node;
 }
 
-std::vector<RouteModel::Node> RoutePlanner::ConstructFinalPath(RouteModel::Node *current_node)
+std::vector<int> RoutePlanner::ConstructFinalPath(int current_node) const
 {
+    /* Count the nodes first so the path is allocated once and filled from the end */
+    int length = 0;
+    for (int node = current_node; node != -1; node = m_Workspace.Parent(node))
+        length++;
+    std::vector<int> path_found(length);
+    for (int node = current_node; node != -1; node = m_Workspace.Parent(node))
+        path_found[--length] = node;
+    return path_found;
+}
+
+float RoutePlanner::CalculateDistance(const std::vector<int> &path) const
+{
+    const double newDistance = m_Kernels.path_length(m_Model.Nodes().data(), path.data(), path.size());
+    // Multiply the distance by the scale of the map to get meters.
+    return newDistance * m_Model.MetricScale();
+}
 
-    distance = 0.0f;
-    std::vector<RouteModel::Node> path_found;
-    /* Iteratively traversing the path from the end to start node */
-    while (current_node != nullptr)
+float RoutePlanner::CalculateTime(const std::vector<int> &path) const
+{
+    return WithProfile(m_Profile, [&](auto profile) { return CalculateTime(path, profile); });
+}
+
+template <typename P>
+float RoutePlanner::CalculateTime(const std::vector<int> &path, P) const
+{
+    const auto &graph = m_Model.RoadGraph();
+    float seconds = 0.0f;
+    for (std::size_t i = 1; i < path.size(); i++)
     {
-        path_found.emplace_back(*current_node);
-        current_node = current_node->parent;
+        float fastest = std::numeric_limits<float>::max();
+        for (int edge = graph.offsets[path[i - 1]]; edge < graph.offsets[path[i - 1] + 1]; edge++)
+            if (graph.targets[edge] == path[i] && P::Allows(graph.types[edge]))
+                fastest = std::min(fastest, graph.lengths[edge] / P::Speed(graph.types[edge]));
+        if (fastest < std::numeric_limits<float>::max())
+            seconds += fastest;
     }
-    std::reverse(path_found.begin(), path_found.end());
-    return path_found;
+    return seconds * m_Model.MetricScale();
 }
 
-float RoutePlanner::CalculateDistance(std::vector<RouteModel::Node> path)
+bool RoutePlanner::AStarSearch()
 {
-    float newDistance = 0.0f;
-    for (int i = path.size() - 1; i >= 1; i--)
+    return WithProfile(m_Profile, [&](auto profile) { return AStarSearch(profile); });
+}
+
+template <typename P>
+bool RoutePlanner::AStarSearch(P profile)
+{
+    /* keeping iterating till the queue has nodes to process */
+    while (!m_OpenList.Empty())
     {
-        newDistance += path[i].distance(*(path[i].parent));
+        const int current_node = NextNode();
+        if (current_node == m_Goal)
+            return true;
+        AddNeighbors(current_node, profile);
     }
-    // Multiply the distance by the scale of the map to get meters.
-    return newDistance * m_Model.MetricScale();
+    return false;
+}
+
+template <typename P>
+float RoutePlanner::ForwardPotential(int node, P) const
+{
+    const auto &graph = m_Model.RoadGraph();
+    return 0.5f * (graph.Distance(node, m_Goal) - graph.Distance(node, m_Start)) * P::kHeuristicScale;
 }
 
-void RoutePlanner::AStarSearch()
+void RoutePlanner::StartBothDirections(int start, int goal, float start_key, float goal_key)
 {
+    m_Start = start;
+    m_Goal = goal;
+    m_Stats = {};
+    const auto node_count = m_Model.SNodes().size();
+    m_Workspace.Reset(node_count);
+    m_OpenList.Reset(node_count);
+    m_ReverseWorkspace.Reset(node_count);
+    m_ReverseOpenList.Reset(node_count);
 
-    RouteModel::Node *current_node = nullptr;
-    start_node->visited = true;
-    RoutePlanner::open_queue.push(start_node);
-    std::vector<RouteModel::Node> path;
-    /* keeping iterating till the queue has nodes to process */
-    while (!open_queue.empty())
+    m_Workspace.Visit(start, -1, 0.0f, start_key);
+    m_OpenList.Push(start, start_key);
+    m_ReverseWorkspace.Visit(goal, -1, 0.0f, goal_key);
+    m_ReverseOpenList.Push(goal, goal_key);
+    m_Stats.pushed += 2;
+
+    m_Meeting = start == goal ? start : -1;
+    m_BestDistance = start == goal ? 0.0f : std::numeric_limits<float>::max();
+}
+
+void RoutePlanner::StartBidirectionalSearch(int start, int goal, Profile profile)
+{
+    /* The backward potential is the negated forward one */
+    m_Start = start;
+    m_Goal = goal;
+    m_Profile = profile;
+    WithProfile(profile, [&](auto p) {
+        StartBothDirections(start, goal, ForwardPotential(start, p), -ForwardPotential(goal, p));
+    });
+}
+
+template <typename P>
+void RoutePlanner::ExpandBidirectional(bool forward, P profile)
+{
+    auto &workspace = forward ? m_Workspace : m_ReverseWorkspace;
+    auto &open_list = forward ? m_OpenList : m_ReverseOpenList;
+    const auto &other = forward ? m_ReverseWorkspace : m_Workspace;
+    const auto &graph = m_Model.RoadGraph();
+
+    const int current_node = open_list.Pop();
+    workspace.Close(current_node);
+    m_Stats.expanded++;
+    const float current_g = workspace.G(current_node);
+    /* Every road segment is stored in both directions, so both searches use the same edges */
+    for (int edge = graph.offsets[current_node]; edge < graph.offsets[current_node + 1]; edge++)
     {
-        current_node = NextNode();
-        if (current_node == end_node)
+        const int node = graph.targets[edge];
+        if (!P::Allows(graph.types[edge]) || workspace.Closed(node))
+            continue;
+        const float g = current_g + P::Cost(graph.types[edge], graph.lengths[edge]);
+        if (!workspace.Visited(node))
+        {
+            const float h = forward ? ForwardPotential(node, profile) : -ForwardPotential(node, profile);
+            workspace.Visit(node, current_node, g, h);
+            open_list.Push(node, g + h);
+            m_Stats.pushed++;
+        }
+        else if (g < workspace.G(node))
         {
-            path = ConstructFinalPath(end_node);
-            distance = CalculateDistance(path);
-            m_Model.path = path;
+            workspace.Visit(node, current_node, g, workspace.H(node));
+            open_list.DecreaseKey(node, g + workspace.H(node));
+            m_Stats.decreased++;
+        }
+        else
+            continue;
+        /* The two searches meet on a node reached from both ends */
+        if (other.Visited(node) && g + other.G(node) < m_BestDistance)
+        {
+            m_BestDistance = g + other.G(node);
+            m_Meeting = node;
+        }
+    }
+}
+
+bool RoutePlanner::BidirectionalSearch()
+{
+    return WithProfile(m_Profile, [&](auto profile) { return BidirectionalSearch(profile); });
+}
+
+template <typename P>
+bool RoutePlanner::BidirectionalSearch(P profile)
+{
+    /* No node left open in either direction can lie on a route shorter than the best one
+       found once the smallest keys of both directions add up to its length */
+    while (!m_OpenList.Empty() && !m_ReverseOpenList.Empty())
+    {
+        const float forward_key = m_OpenList.TopKey(), reverse_key = m_ReverseOpenList.TopKey();
+        if (forward_key + reverse_key >= m_BestDistance)
             break;
+        ExpandBidirectional(forward_key <= reverse_key, profile);
+    }
+    return m_Meeting != -1;
+}
+
+std::vector<int> RoutePlanner::ConstructBidirectionalPath() const
+{
+    /* Start to meeting node along the forward parents, then on to the goal along the backward ones */
+    int forward_length = 0, length = 0;
+    for (int node = m_Meeting; node != -1; node = m_Workspace.Parent(node))
+        forward_length++;
+    length = forward_length;
+    for (int node = m_ReverseWorkspace.Parent(m_Meeting); node != -1; node = m_ReverseWorkspace.Parent(node))
+        length++;
+    std::vector<int> path_found(length);
+    int i = forward_length;
+    for (int node = m_Meeting; node != -1; node = m_Workspace.Parent(node))
+        path_found[--i] = node;
+    i = forward_length;
+    for (int node = m_ReverseWorkspace.Parent(m_Meeting); node != -1; node = m_ReverseWorkspace.Parent(node))
+        path_found[i++] = node;
+    return path_found;
+}
+
+void RoutePlanner::StartHierarchySearch(int start, int goal)
+{
+    /* Plain Dijkstra in both directions: keys are distances, h stays zero */
+    m_Profile = Profile::Distance;
+    StartBothDirections(start, goal, 0.0f, 0.0f);
+}
+
+void RoutePlanner::ExpandUpward(bool forward)
+{
+    auto &workspace = forward ? m_Workspace : m_ReverseWorkspace;
+    auto &open_list = forward ? m_OpenList : m_ReverseOpenList;
+    const auto &other = forward ? m_ReverseWorkspace : m_Workspace;
+    const auto &upward = m_Model.Hierarchy()->Upward();
+
+    const int current_node = open_list.Pop();
+    workspace.Close(current_node);
+    m_Stats.expanded++;
+    const float current_g = workspace.G(current_node);
+    if (other.Visited(current_node) && current_g + other.G(current_node) < m_BestDistance)
+    {
+        m_BestDistance = current_g + other.G(current_node);
+        m_Meeting = current_node;
+    }
+    for (int edge = upward.offsets[current_node]; edge < upward.offsets[current_node + 1]; edge++)
+    {
+        const int node = upward.targets[edge];
+        if (workspace.Closed(node))
+            continue;
+        const float g = current_g + upward.lengths[edge];
+        if (!workspace.Visited(node))
+        {
+            workspace.Visit(node, current_node, g, 0.0f);
+            open_list.Push(node, g);
+            m_Stats.pushed++;
+        }
+        else if (g < workspace.G(node))
+        {
+            workspace.Visit(node, current_node, g, 0.0f);
+            open_list.DecreaseKey(node, g);
+            m_Stats.decreased++;
+        }
+        else
+            continue;
+        if (other.Visited(node) && g + other.G(node) < m_BestDistance)
+        {
+            m_BestDistance = g + other.G(node);
+            m_Meeting = node;
         }
-        AddNeighbors(current_node);
     }
-}
\ No newline at end of file
+}
+
+bool RoutePlanner::HierarchySearch()
+{
+    /* Each direction stops on its own once its smallest key reaches the best route found, as
+       every route through its remaining nodes is at least that long */
+    while (true)
+    {
+        const bool forward = !m_OpenList.Empty() && m_OpenList.TopKey() < m_BestDistance;
+        const bool reverse = !m_ReverseOpenList.Empty() && m_ReverseOpenList.TopKey() < m_BestDistance;
+        if (!forward && !reverse)
+            break;
+        ExpandUpward(forward && (!reverse || m_OpenList.TopKey() <= m_ReverseOpenList.TopKey()));
+    }
+    return m_Meeting != -1;
+}
+
+std::vector<int> RoutePlanner::ConstructHierarchyPath() const
+{
+    /* Hierarchy nodes from start up to the meeting node and down to the goal, then every edge
+       between them unpacked into road segments */
+    std::vector<int> hops;
+    for (int node = m_Meeting; node != -1; node = m_Workspace.Parent(node))
+        hops.push_back(node);
+    std::reverse(hops.begin(), hops.end());
+    for (int node = m_ReverseWorkspace.Parent(m_Meeting); node != -1; node = m_ReverseWorkspace.Parent(node))
+        hops.push_back(node);
+
+    std::vector<int> path_found;
+    m_Model.Hierarchy()->Unpack(hops, path_found);
+    return path_found;
+}
@@ -4,39 +4,118 @@
 #include <iostream>
 #include <vector>
 #include <string>
-#include <queue>
+#include "distance_kernel.h"
 #include "route_model.h"
+#include "routing_profile.h"
+#include "open_list.h"
+#include "search_workspace.h"
 
+// Answers route queries on a shared, read-only RouteModel. All search state lives in the
+// planner's workspace, so a planner can be reused for any number of queries. Every query picks a
+// routing profile; the searches are templates over the profile types, so edge costs and access
+// rules compile into the search loops.
 class RoutePlanner
 {
 public:
-  class CompareNodes
+  struct Stats
   {
-  public:
-    bool operator()(RouteModel::Node *node1, RouteModel::Node *node2);
+    int expanded = 0;          // Nodes taken off the open list.
+    int pushed = 0;            // Nodes added to the open list.
+    int decreased = 0;         // Open nodes reached again on a shorter path.
+    double milliseconds = 0.0; // Wall time of the query.
   };
-  RoutePlanner(RouteModel &model, float start_x, float start_y, float end_x, float end_y);
-  // Add public variables or methods declarations here.
-  float GetDistance() const { return distance; }
-  float CalculateDistance(std::vector<RouteModel::Node> path);
-  void AStarSearch();
+
+  struct Result
+  {
+    std::vector<int> path; // Node indices from start to goal, empty when no route exists.
+    float distance = 0.0f;              // Meters.
+    float seconds = 0.0f;               // Travel time at the speeds of the query's profile.
+    Stats stats;
+  };
+
+  enum class Search
+  {
+    Forward,       // A* from the start towards the goal.
+    Bidirectional, // A* from both ends at once, meeting in the middle.
+    Hierarchy,     // Upward searches in the model's contraction hierarchy. Forward without one or
+                   // with a profile other than Profile::Distance.
+    Landmarks,     // A* with the model's landmark bounds added to the heuristic. Forward without
+                   // them or with a profile that uses other roads than Profile::Distance.
+  };
+
+  RoutePlanner(const RouteModel &model);
+  // Route between two nodes of the model. The profile decides which roads the route may use and
+  // what it minimizes: distance for Profile::Distance, travel time for the others.
+  Result Route(int start, int goal, Search search = Search::Forward, Profile profile = Profile::Distance);
+  // Route between the nodes closest to two points given in percent of the map's extent, snapped
+  // to roads the profile may use.
+  Result Route(float start_x, float start_y, float end_x, float end_y, Search search = Search::Forward,
+               Profile profile = Profile::Distance);
 
   // The following methods have been made public so we can test them individually.
-  void AddNeighbors(RouteModel::Node *current_node);
-  float CalculateHValue(RouteModel::Node const *node);
-  std::vector<RouteModel::Node> ConstructFinalPath(RouteModel::Node *);
-  RouteModel::Node *NextNode();
+  // They operate on the query set up by StartSearch, which uses the landmark bounds when asked
+  // to and the model has them. g and h values are in the cost units of the profile.
+  void StartSearch(int start, int goal, bool use_landmarks = false, Profile profile = Profile::Distance);
+  bool AStarSearch();
+  void AddNeighbors(int current_node);
+  float CalculateHValue(int node) const;
+  std::vector<int> ConstructFinalPath(int current_node) const;
+  float CalculateDistance(const std::vector<int> &path) const;
+  // Seconds to travel path at the speeds of the current profile, taking the fastest of the roads
+  // it may use between each pair of nodes.
+  float CalculateTime(const std::vector<int> &path) const;
+  int NextNode();
+  SearchWorkspace &Workspace() { return m_Workspace; }
 
-private:
-  // Add private variables or methods declarations here.
+  // Bidirectional search, set up by StartBidirectionalSearch. Both directions use the average
+  // of the two straight-line potentials, which keeps them consistent with each other, and the
+  // search stops once the two smallest open keys add up to the best route found so far.
+  void StartBidirectionalSearch(int start, int goal, Profile profile = Profile::Distance);
+  bool BidirectionalSearch();
+  std::vector<int> ConstructBidirectionalPath() const;
 
-  std::priority_queue<RouteModel::Node *, std::vector<RouteModel::Node *>, CompareNodes> open_queue;
+  // Contraction hierarchy search, set up by StartHierarchySearch. Needs m_Model.Hierarchy().
+  // Both directions only follow edges towards more important nodes and meet at the most
+  // important node of the route; shortcuts are unpacked into road segments afterwards.
+  void StartHierarchySearch(int start, int goal);
+  bool HierarchySearch();
+  std::vector<int> ConstructHierarchyPath() const;
 
-  RouteModel::Node *start_node;
-  RouteModel::Node *end_node;
+private:
+  // Instantiations of the searches for one profile. The public methods dispatch on m_Profile
+  // once and the loops below call each other directly.
+  template <typename P> bool AStarSearch(P profile);
+  template <typename P> void AddNeighbors(int current_node, P profile);
+  template <typename P> float CalculateHValue(int node, P profile) const;
+  // h of node given its straight-line distance to the goal.
+  template <typename P> float CalculateHValue(int node, float straight, P profile) const;
+  template <typename P> float CalculateTime(const std::vector<int> &path, P profile) const;
+  template <typename P> bool BidirectionalSearch(P profile);
+  template <typename P> float ForwardPotential(int node, P profile) const;
+  // Expands the top node of one direction of the bidirectional search.
+  template <typename P> void ExpandBidirectional(bool forward, P profile);
+  // Expands the top node of one direction of the hierarchy search.
+  void ExpandUpward(bool forward);
+  // Resets both directions and opens start and goal with the given keys.
+  void StartBothDirections(int start, int goal, float start_key, float goal_key);
 
-  float distance = 0.0f;
-  RouteModel &m_Model;
+  const RouteModel &m_Model;
+  const DistanceKernels &m_Kernels;
+  // Straight-line distances to the goal of the neighbors of the node being expanded, computed
+  // for all of them at once. Sized for the largest node degree of the graph.
+  std::vector<float> m_NeighborDistances;
+  SearchWorkspace m_Workspace;
+  OpenList m_OpenList; // Keyed by g + h.
+  // The backward half of a bidirectional search, growing from the goal.
+  SearchWorkspace m_ReverseWorkspace;
+  OpenList m_ReverseOpenList;
+  int m_Meeting = -1;          // Node joining the best route found by searching from both ends.
+  float m_BestDistance = 0.0f; // Its cost.
+  int m_Start = -1;
+  int m_Goal = -1;
+  bool m_UseLandmarks = false;
+  Profile m_Profile = Profile::Distance;
+  Stats m_Stats;
 };
 
-#endif
\ No newline at end of file
+#endif
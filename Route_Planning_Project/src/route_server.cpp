@@ -0,0 +1,390 @@
+#include "route_server.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <utility>
+
+RouteServer::RouteServer(const RouteModel &model, unsigned threads)
+    : m_Model(model), m_Engine(std::make_unique<RouteEngine>(model, threads))
+{
+    int wake[2];
+    if (pipe2(wake, O_NONBLOCK | O_CLOEXEC) != 0)
+        throw std::logic_error("failed to create the server's wake-up pipe");
+    m_WakeRead = wake[0];
+    m_WakeWrite = wake[1];
+}
+
+RouteServer::~RouteServer()
+{
+    m_Stopping = true;
+    m_Engine.reset();
+    for (auto &[id, connection] : m_Connections)
+        close(connection.fd);
+    if (m_Listener >= 0)
+        close(m_Listener);
+    if (!m_UnixPath.empty())
+        unlink(m_UnixPath.c_str());
+    close(m_WakeRead);
+    close(m_WakeWrite);
+}
+
+bool RouteServer::Listen(const std::string &address)
+{
+    if (m_Listener >= 0)
+        return false;
+
+    int fd = -1;
+    if (address.rfind("unix:", 0) == 0)
+    {
+        const auto path = address.substr(5);
+        sockaddr_un local{};
+        local.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(local.sun_path))
+            return false;
+        std::memcpy(local.sun_path, path.c_str(), path.size() + 1);
+        // A socket left behind by a previous server would make bind fail; anything else at the
+        // path is not ours to remove.
+        struct stat existing;
+        if (stat(path.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode))
+            unlink(path.c_str());
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0 || bind(fd, (const sockaddr *)&local, sizeof(local)) != 0 || listen(fd, SOMAXCONN) != 0)
+        {
+            if (fd >= 0)
+                close(fd);
+            return false;
+        }
+        m_UnixPath = path;
+    }
+    else
+    {
+        const auto colon = address.rfind(':');
+        const auto host = colon == std::string::npos ? std::string{"127.0.0.1"} : address.substr(0, colon);
+        const auto port = colon == std::string::npos ? address : address.substr(colon + 1);
+        char *end = nullptr;
+        const long number = std::strtol(port.c_str(), &end, 10);
+        sockaddr_in local{};
+        local.sin_family = AF_INET;
+        local.sin_port = htons((std::uint16_t)number);
+        if (port.empty() || *end || number < 0 || number > 65535 || inet_pton(AF_INET, host.c_str(), &local.sin_addr) != 1)
+            return false;
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        const int on = 1;
+        socklen_t length = sizeof(local);
+        if (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0 ||
+            bind(fd, (const sockaddr *)&local, sizeof(local)) != 0 || listen(fd, SOMAXCONN) != 0 ||
+            getsockname(fd, (sockaddr *)&local, &length) != 0)
+        {
+            if (fd >= 0)
+                close(fd);
+            return false;
+        }
+        m_Port = ntohs(local.sin_port);
+    }
+    m_Listener = fd;
+    return true;
+}
+
+void RouteServer::Run()
+{
+    std::vector<pollfd> polled;
+    std::vector<std::uint64_t> ids; // Connection of polled[i + 2].
+    while (!m_Stopping)
+    {
+        polled.assign({{m_WakeRead, POLLIN, 0}, {m_Listener, POLLIN, 0}});
+        ids.clear();
+        for (auto &[id, connection] : m_Connections)
+        {
+            short events = 0;
+            if (!connection.input_closed && connection.Pending() < kMaxPending)
+                events |= POLLIN;
+            if (!connection.output.empty())
+                events |= POLLOUT;
+            polled.push_back({connection.fd, events, 0});
+            ids.push_back(id);
+        }
+        if (poll(polled.data(), polled.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        if (polled[0].revents)
+        {
+            char drain[256];
+            while (read(m_WakeRead, drain, sizeof(drain)) > 0)
+                ;
+            CollectCompletions();
+        }
+        if (polled[1].revents & POLLIN)
+            Accept();
+        for (std::size_t i = 0; i < ids.size(); i++)
+        {
+            const auto events = polled[i + 2].revents;
+            auto found = m_Connections.find(ids[i]);
+            if (!events || found == m_Connections.end())
+                continue;
+            auto &connection = found->second;
+            // A hung up client can no longer read answers; one that only shut down its sending
+            // side still gets them.
+            bool open = !(events & (POLLHUP | POLLERR | POLLNVAL));
+            if (open && (events & POLLIN))
+                open = Read(ids[i], connection);
+            if (open && (events & POLLOUT))
+                open = Write(connection);
+            if (!open)
+            {
+                close(connection.fd);
+                m_Connections.erase(found);
+            }
+        }
+    }
+
+    for (auto &[id, connection] : m_Connections)
+        close(connection.fd);
+    m_Connections.clear();
+}
+
+void RouteServer::Stop()
+{
+    m_Stopping = true;
+    Wake();
+}
+
+void RouteServer::Accept()
+{
+    while (true)
+    {
+        const int fd = accept4(m_Listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return;
+        if (m_UnixPath.empty())
+        {
+            // Answers are small and each one should leave as soon as it is ready.
+            const int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        }
+        m_Connections[m_NextConnection++].fd = fd;
+    }
+}
+
+bool RouteServer::Read(std::uint64_t id, Connection &connection)
+{
+    char buffer[64 * 1024];
+    // Requests are dispatched as they arrive, and reading stops once kMaxPending of them are
+    // queued: the rest of a burst waits in the socket rather than in memory or the pool.
+    while (!connection.input_closed && connection.Pending() < kMaxPending)
+    {
+        const auto count = recv(connection.fd, buffer, sizeof(buffer), 0);
+        if (count == 0)
+        {
+            connection.input_closed = true;
+            break;
+        }
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return false;
+        }
+        connection.input.append(buffer, count);
+        if (!DispatchBuffered(id, connection))
+            return false;
+    }
+    // A client that sent its last request is closed once every answer has been written.
+    return DispatchBuffered(id, connection) && !connection.Done();
+}
+
+bool RouteServer::DispatchBuffered(std::uint64_t id, Connection &connection)
+{
+    std::size_t begin = 0;
+    for (std::size_t end; connection.Pending() < kMaxPending &&
+                          (end = connection.input.find('\n', begin)) != std::string::npos; begin = end + 1)
+    {
+        auto request = connection.input.substr(begin, end - begin);
+        if (!request.empty() && request.back() == '\r')
+            request.pop_back();
+        if (request.find_first_not_of(" \t") != std::string::npos)
+            Dispatch(id, connection, std::move(request));
+    }
+    connection.input.erase(0, begin);
+
+    const auto newline = connection.input.rfind('\n');
+    if (newline == std::string::npos)
+    {
+        if (connection.input.size() > kMaxLine)
+            return false;
+        // The last request may end without a line break.
+        if (connection.input_closed && connection.Pending() < kMaxPending)
+        {
+            if (connection.input.find_first_not_of(" \t\r") != std::string::npos)
+                Dispatch(id, connection, std::move(connection.input));
+            connection.input.clear();
+        }
+    }
+    return connection.input.size() - (newline == std::string::npos ? 0 : newline + 1) <= kMaxLine;
+}
+
+bool RouteServer::Write(Connection &connection)
+{
+    std::size_t written = 0;
+    while (written < connection.output.size())
+    {
+        const auto count = send(connection.fd, connection.output.data() + written, connection.output.size() - written,
+                                MSG_NOSIGNAL);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return false;
+        }
+        written += count;
+    }
+    connection.output.erase(0, written);
+    return !connection.Done();
+}
+
+void RouteServer::Dispatch(std::uint64_t id, Connection &connection, std::string request)
+{
+    const auto sequence = connection.next_request++;
+    m_Engine->Submit([this, id, sequence, request = std::move(request)](RoutePlanner &planner) {
+        std::string answer;
+        if (!m_Stopping)
+        {
+            try
+            {
+                answer = Answer(m_Model, planner, request);
+            }
+            catch (const std::exception &e)
+            {
+                answer = std::string{"error "} + e.what();
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_CompletionsMutex);
+            m_Completions.push_back({id, sequence, std::move(answer)});
+        }
+        Wake();
+    });
+}
+
+void RouteServer::CollectCompletions()
+{
+    std::vector<Completion> completions;
+    {
+        std::lock_guard<std::mutex> lock(m_CompletionsMutex);
+        std::swap(completions, m_Completions);
+    }
+    for (auto &completion : completions)
+    {
+        auto found = m_Connections.find(completion.connection);
+        if (found == m_Connections.end())
+            continue;
+        auto &connection = found->second;
+        connection.ready.emplace(completion.request, std::move(completion.answer));
+        for (auto next = connection.ready.begin();
+             next != connection.ready.end() && next->first == connection.next_answer;
+             next = connection.ready.erase(next))
+        {
+            connection.output += next->second;
+            connection.output += '\n';
+            connection.next_answer++;
+        }
+    }
+    // Answers go out right away rather than on the next round of the loop, and requests held back
+    // while the connection had kMaxPending queued are dispatched as answers make room.
+    for (auto connection = m_Connections.begin(); connection != m_Connections.end();)
+    {
+        auto &[id, state] = *connection;
+        bool open = state.input.empty() || DispatchBuffered(id, state);
+        if (open)
+            open = state.output.empty() ? !state.Done() : Write(state);
+        if (!open)
+        {
+            close(state.fd);
+            connection = m_Connections.erase(connection);
+        }
+        else
+            ++connection;
+    }
+}
+
+void RouteServer::Wake()
+{
+    const char byte = 0;
+    // A full pipe already holds a wake-up.
+    [[maybe_unused]] auto ignored = write(m_WakeWrite, &byte, 1);
+}
+
+std::string RouteServer::Answer(const RouteModel &model, RoutePlanner &planner, std::string_view request)
+{
+    std::vector<std::string> tokens;
+    for (std::size_t begin = 0, end; begin < request.size(); begin = end)
+    {
+        begin = request.find_first_not_of(" \t", begin);
+        if (begin == std::string_view::npos)
+            break;
+        end = std::min(request.find_first_of(" \t", begin), request.size());
+        tokens.emplace_back(request.substr(begin, end - begin));
+    }
+    if (tokens.size() < 4 || tokens.size() > 6)
+        return "error expected: start_x start_y end_x end_y [profile] [search]";
+
+    float coordinates[4];
+    for (int i = 0; i < 4; i++)
+    {
+        char *end = nullptr;
+        coordinates[i] = std::strtof(tokens[i].c_str(), &end);
+        if (end == tokens[i].c_str() || *end || !std::isfinite(coordinates[i]))
+            return "error bad coordinate: " + tokens[i];
+    }
+    Profile profile = Profile::Distance;
+    auto search = model.Hierarchy() || !model.Landmarks() ? RoutePlanner::Search::Hierarchy
+                                                          : RoutePlanner::Search::Landmarks;
+    for (std::size_t i = 4; i < tokens.size(); i++)
+    {
+        const auto &option = tokens[i];
+        if (option == "distance" || option == "car" || option == "bike" || option == "foot")
+            profile = option == "car" ? Profile::Car : option == "bike" ? Profile::Bike : option == "foot" ? Profile::Foot : Profile::Distance;
+        else if (option == "forward")
+            search = RoutePlanner::Search::Forward;
+        else if (option == "bidirectional")
+            search = RoutePlanner::Search::Bidirectional;
+        else if (option == "landmarks")
+            search = RoutePlanner::Search::Landmarks;
+        else if (option == "hierarchy")
+            search = RoutePlanner::Search::Hierarchy;
+        else
+            return "error unknown option: " + option;
+    }
+
+    const auto result = planner.Route(coordinates[0], coordinates[1], coordinates[2], coordinates[3], search, profile);
+    char number[64];
+    std::snprintf(number, sizeof(number), "ok %.1f %.1f %zu", result.distance, result.seconds, result.path.size());
+    std::string answer = number;
+    answer.reserve(answer.size() + result.path.size() * 16);
+    for (int node : result.path)
+    {
+        const auto &point = model.SNodes()[node];
+        std::snprintf(number, sizeof(number), " %.4f %.4f", point.x * 100.0, point.y * 100.0);
+        answer += number;
+    }
+    return answer;
+}
@@ -0,0 +1,107 @@
+#ifndef ROUTE_SERVER_H
+#define ROUTE_SERVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "route_engine.h"
+#include "route_model.h"
+
+// Answers route requests over a local socket, headless, on one shared RouteModel. A single
+// thread runs the event loop: it accepts connections, reads requests and writes answers, while
+// the searches run on the workers of a RouteEngine. Clients may pipeline any number of requests
+// on one connection; answers come back in request order.
+//
+// The protocol is line based. A request is
+//   <start_x> <start_y> <end_x> <end_y> [distance|car|bike|foot] [forward|bidirectional|landmarks|hierarchy]
+// with coordinates in percent of the map's extent, as the interactive program takes them. The
+// profile defaults to distance and the search to the fastest the model supports. The answer is
+//   ok <meters> <seconds> <node count> <x> <y> ...
+// listing the route's nodes in percent as well, with a node count of 0 when no route exists, or
+//   error <message>
+// for a request that cannot be parsed.
+class RouteServer
+{
+public:
+  // threads == 0 uses one worker per hardware thread.
+  explicit RouteServer(const RouteModel &model, unsigned threads = 0);
+  ~RouteServer();
+
+  RouteServer(const RouteServer &) = delete;
+  RouteServer &operator=(const RouteServer &) = delete;
+
+  // Listens on "unix:<path>" for a Unix domain socket, or on "[host:]port" for TCP, where the
+  // host defaults to 127.0.0.1 and port 0 picks a free one. False when the socket cannot be set up.
+  bool Listen(const std::string &address);
+  // TCP port listened on, 0 for Unix domain sockets.
+  int Port() const noexcept { return m_Port; }
+
+  // Serves until Stop() is called, then closes every connection. Requests still being searched
+  // when it returns are not answered.
+  void Run();
+  // Makes Run() return; may be called from any thread, including before Run().
+  void Stop();
+
+  // Queued requests per connection at which it is no longer read from until answers catch up.
+  static constexpr std::uint64_t kMaxPending = 4096;
+  // Longest request line accepted; a connection sending a longer one is closed.
+  static constexpr std::size_t kMaxLine = 4096;
+
+  // Answer to one request line, without the line break.
+  static std::string Answer(const RouteModel &model, RoutePlanner &planner, std::string_view request);
+
+private:
+  struct Connection
+  {
+    int fd;
+    std::string input;
+    std::string output;
+    std::uint64_t next_request = 0;  // Sequence number of the next request read.
+    std::uint64_t next_answer = 0;   // Sequence number of the next answer to write.
+    std::map<std::uint64_t, std::string> ready; // Answers that arrived ahead of an earlier one.
+    bool input_closed = false;       // The client has sent its last request.
+
+    std::uint64_t Pending() const noexcept { return next_request - next_answer; }
+    // Every request has been answered and written and the client will send no more.
+    bool Done() const noexcept { return input_closed && input.empty() && !Pending() && output.empty(); }
+  };
+  struct Completion
+  {
+    std::uint64_t connection;
+    std::uint64_t request;
+    std::string answer;
+  };
+
+  void Accept();
+  // False once the connection is closed or broken.
+  bool Read(std::uint64_t id, Connection &connection);
+  bool Write(Connection &connection);
+  // Dispatches the buffered complete requests while fewer than kMaxPending are queued, and the
+  // last one once the client has sent it. False when the incomplete line is longer than kMaxLine.
+  bool DispatchBuffered(std::uint64_t id, Connection &connection);
+  void Dispatch(std::uint64_t id, Connection &connection, std::string request);
+  void CollectCompletions();
+  void Wake();
+
+  const RouteModel &m_Model;
+  std::string m_UnixPath;
+  int m_Listener = -1;
+  int m_Port = 0;
+  int m_WakeRead = -1;
+  int m_WakeWrite = -1;
+  std::atomic<bool> m_Stopping{false};
+  std::map<std::uint64_t, Connection> m_Connections;
+  std::uint64_t m_NextConnection = 0;
+  std::mutex m_CompletionsMutex;
+  std::vector<Completion> m_Completions;
+  // Reset first when the server is destroyed, so its workers are joined before the state their
+  // tasks report to goes away.
+  std::unique_ptr<RouteEngine> m_Engine;
+};
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef ROUTING_PROFILE_H
+#define ROUTING_PROFILE_H
+
+#include <cstdint>
+#include "model.h"
+
+// Routing profiles are policy types the search is instantiated with, so their rules inline into
+// the edge loop:
+//   Allows(type)         - whether roads of this type may be used
+//   Speed(type)          - travel speed on them in meters per second
+//   Cost(type, length)   - what the search minimizes for a segment of the given length
+//   kHeuristicScale      - straight-line distance times this never exceeds the cost of a route,
+//                          which keeps A* optimal
+//   kRoads               - RoadMask of the allowed types, for snapping points to usable roads
+// Costs are in model units: lengths like RouteModel::Graph, times as length / speed, so both
+// become meters or seconds when multiplied by MetricScale().
+
+using RoadType = Model::Road::Type;
+
+constexpr std::uint32_t RoadMask(RoadType type) { return 1u << type; }
+
+namespace profile_detail {
+
+constexpr float KilometersPerHour(float speed) { return speed / 3.6f; }
+
+constexpr float CarSpeed(RoadType type)
+{
+    switch (type)
+    {
+    case Model::Road::Motorway:     return KilometersPerHour(110.0f);
+    case Model::Road::Trunk:        return KilometersPerHour(90.0f);
+    case Model::Road::Primary:      return KilometersPerHour(70.0f);
+    case Model::Road::Secondary:    return KilometersPerHour(60.0f);
+    case Model::Road::Tertiary:     return KilometersPerHour(50.0f);
+    case Model::Road::Unclassified: return KilometersPerHour(40.0f);
+    case Model::Road::Residential:  return KilometersPerHour(30.0f);
+    case Model::Road::Service:      return KilometersPerHour(15.0f);
+    default:                        return KilometersPerHour(30.0f);
+    }
+}
+
+constexpr std::uint32_t kAllRoads = RoadMask(Model::Road::Unclassified) | RoadMask(Model::Road::Service) |
+    RoadMask(Model::Road::Residential) | RoadMask(Model::Road::Tertiary) | RoadMask(Model::Road::Secondary) |
+    RoadMask(Model::Road::Primary) | RoadMask(Model::Road::Trunk) | RoadMask(Model::Road::Motorway) |
+    RoadMask(Model::Road::Footway);
+
+}
+
+// Shortest distance over every road but footways, as routes have always been planned. Travel
+// times use car speeds.
+struct DistanceProfile
+{
+    static constexpr std::uint32_t kRoads = profile_detail::kAllRoads & ~RoadMask(Model::Road::Footway);
+    static constexpr float kHeuristicScale = 1.0f;
+    static constexpr bool Allows(RoadType type) { return type != Model::Road::Footway; }
+    static constexpr float Speed(RoadType type) { return profile_detail::CarSpeed(type); }
+    static constexpr float Cost(RoadType, float length) { return length; }
+};
+
+// Fastest route by car.
+struct CarProfile
+{
+    static constexpr std::uint32_t kRoads = DistanceProfile::kRoads;
+    static constexpr float kHeuristicScale = 1.0f / profile_detail::KilometersPerHour(110.0f);
+    static constexpr bool Allows(RoadType type) { return type != Model::Road::Footway; }
+    static constexpr float Speed(RoadType type) { return profile_detail::CarSpeed(type); }
+    static constexpr float Cost(RoadType type, float length) { return length / Speed(type); }
+};
+
+// Fastest route by bike: no motorways or trunk roads, slower on footways and service roads.
+struct BikeProfile
+{
+    static constexpr std::uint32_t kRoads = profile_detail::kAllRoads & ~RoadMask(Model::Road::Motorway) & ~RoadMask(Model::Road::Trunk);
+    static constexpr float kHeuristicScale = 1.0f / profile_detail::KilometersPerHour(18.0f);
+    static constexpr bool Allows(RoadType type) { return (kRoads & RoadMask(type)) != 0; }
+    static constexpr float Speed(RoadType type)
+    {
+        return type == Model::Road::Footway ? profile_detail::KilometersPerHour(10.0f) :
+               type == Model::Road::Service ? profile_detail::KilometersPerHour(14.0f) :
+                                              profile_detail::KilometersPerHour(18.0f);
+    }
+    static constexpr float Cost(RoadType type, float length) { return length / Speed(type); }
+};
+
+// Fastest route on foot: every road but motorways and trunk roads, at walking speed.
+struct FootProfile
+{
+    static constexpr std::uint32_t kRoads = BikeProfile::kRoads;
+    static constexpr float kHeuristicScale = 1.0f / profile_detail::KilometersPerHour(5.0f);
+    static constexpr bool Allows(RoadType type) { return (kRoads & RoadMask(type)) != 0; }
+    static constexpr float Speed(RoadType) { return profile_detail::KilometersPerHour(5.0f); }
+    static constexpr float Cost(RoadType type, float length) { return length / Speed(type); }
+};
+
+// Runtime choice of a profile, turned into one of the policy types by WithProfile.
+enum class Profile
+{
+    Distance,
+    Car,
+    Bike,
+    Foot,
+};
+
+// Calls f with a default constructed policy object of the chosen profile.
+template <typename F>
+decltype(auto) WithProfile(Profile profile, F &&f)
+{
+    switch (profile)
+    {
+    case Profile::Car:  return f(CarProfile{});
+    case Profile::Bike: return f(BikeProfile{});
+    case Profile::Foot: return f(FootProfile{});
+    default:            return f(DistanceProfile{});
+    }
+}
+
+#endif
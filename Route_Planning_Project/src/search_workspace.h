@@ -0,0 +1,56 @@
+#ifndef SEARCH_WORKSPACE_H
+#define SEARCH_WORKSPACE_H
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Per-query A* state, kept apart from the model so one model can answer any number of queries.
+// Every field lives in its own dense array, so a search loop only pulls in the bytes it reads.
+// Every entry is stamped with the query that wrote it and entries with an older stamp read as
+// unvisited, so starting a query is O(1) instead of clearing one slot per node. A query owns
+// two stamp values, the second marking closed nodes, so skipping closed neighbors and checking
+// whether the rest were visited read the same array.
+class SearchWorkspace
+{
+public:
+  // Starts a new query over a graph of node_count nodes.
+  void Reset(std::size_t node_count)
+  {
+    m_Epoch += 2;
+    if (m_Stamps.size() != node_count || m_Epoch < 2)
+    {
+      m_Stamps.assign(node_count, 0);
+      m_G.resize(node_count);
+      m_H.resize(node_count);
+      m_Parents.resize(node_count);
+      m_Epoch = 2;
+    }
+  }
+
+  bool Visited(int node) const { return m_Stamps[node] - m_Epoch < 2; }
+  float G(int node) const { return Visited(node) ? m_G[node] : std::numeric_limits<float>::max(); }
+  float H(int node) const { return m_H[node]; }
+  int Parent(int node) const { return Visited(node) ? m_Parents[node] : -1; }
+  // Closed nodes have been expanded and their g value is final. Only visited nodes can be closed.
+  bool Closed(int node) const { return m_Stamps[node] == m_Epoch + 1; }
+  void Close(int node) { m_Stamps[node] = m_Epoch + 1; }
+
+  // Records that node was reached from parent (-1 for the start node). Reopens closed nodes.
+  void Visit(int node, int parent, float g, float h)
+  {
+    m_Stamps[node] = m_Epoch;
+    m_Parents[node] = parent;
+    m_G[node] = g;
+    m_H[node] = h;
+  }
+
+private:
+  std::uint32_t m_Epoch = 0;
+  std::vector<std::uint32_t> m_Stamps; // m_Epoch when visited, m_Epoch + 1 once closed.
+  std::vector<float> m_G;
+  std::vector<float> m_H;
+  std::vector<int> m_Parents;
+};
+
+#endif
@@ -0,0 +1,197 @@
+#include "spatial_index.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+
+SpatialIndex::SpatialIndex(const std::vector<Model::Node> &nodes, const std::vector<int> &members)
+{
+    std::vector<int> ids = members;
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    if (ids.empty())
+        return;
+
+    double max_x = nodes[ids.front()].x, max_y = nodes[ids.front()].y;
+    m_MinX = max_x;
+    m_MinY = max_y;
+    for (int id : ids)
+    {
+        m_MinX = std::min(m_MinX, nodes[id].x);
+        m_MinY = std::min(m_MinY, nodes[id].y);
+        max_x = std::max(max_x, nodes[id].x);
+        max_y = std::max(max_y, nodes[id].y);
+    }
+
+    // Square cells sized so that a cell holds kNodesPerCell nodes on average.
+    const double width = max_x - m_MinX, height = max_y - m_MinY;
+    const double cells = std::max(1.0, double(ids.size()) / kNodesPerCell);
+    if (width > 0 && height > 0)
+        m_CellSize = std::sqrt(width * height / cells);
+    else if (width > 0 || height > 0)
+        m_CellSize = std::max(width, height) / cells;
+    m_Columns = int(width / m_CellSize) + 1;
+    m_Rows = int(height / m_CellSize) + 1;
+
+    // Counting sort of the nodes by cell; slots of a cell keep ascending node order.
+    std::vector<int> cell_of(ids.size());
+    m_Cells.assign(std::size_t(m_Columns) * m_Rows + 1, 0);
+    for (std::size_t i = 0; i < ids.size(); i++)
+    {
+        cell_of[i] = CellY(nodes[ids[i]].y) * m_Columns + CellX(nodes[ids[i]].x);
+        m_Cells[cell_of[i] + 1]++;
+    }
+    for (std::size_t i = 1; i < m_Cells.size(); i++)
+        m_Cells[i] += m_Cells[i - 1];
+    m_X.resize(ids.size());
+    m_Y.resize(ids.size());
+    m_Ids.resize(ids.size());
+    std::vector<int> next(m_Cells.begin(), m_Cells.end() - 1);
+    for (std::size_t i = 0; i < ids.size(); i++)
+    {
+        const int slot = next[cell_of[i]]++;
+        m_X[slot] = nodes[ids[i]].x;
+        m_Y[slot] = nodes[ids[i]].y;
+        m_Ids[slot] = ids[i];
+    }
+}
+
+int SpatialIndex::CellX(double x) const
+{
+    return (int)std::clamp(std::floor((x - m_MinX) / m_CellSize), 0.0, double(m_Columns - 1));
+}
+
+int SpatialIndex::CellY(double y) const
+{
+    return (int)std::clamp(std::floor((y - m_MinY) / m_CellSize), 0.0, double(m_Rows - 1));
+}
+
+template <typename F>
+void SpatialIndex::VisitRing(int cx, int cy, int r, F &&visit) const
+{
+    const int first_row = std::max(cy - r, 0), last_row = std::min(cy + r, m_Rows - 1);
+    for (int row = first_row; row <= last_row; row++)
+    {
+        // Rows on the edge of the ring are visited whole, as one run of slots since their cells
+        // are adjacent. The others only at both ends.
+        const int row_start = row * m_Columns;
+        if (row == cy - r || row == cy + r)
+        {
+            const int first = std::max(cx - r, 0), last = std::min(cx + r, m_Columns - 1);
+            if (m_Cells[row_start + first] < m_Cells[row_start + last + 1])
+                visit(m_Cells[row_start + first], m_Cells[row_start + last + 1]);
+            continue;
+        }
+        for (int column : {cx - r, cx + r})
+            if (column >= 0 && column < m_Columns && m_Cells[row_start + column] < m_Cells[row_start + column + 1])
+                visit(m_Cells[row_start + column], m_Cells[row_start + column + 1]);
+    }
+}
+
+double SpatialIndex::OutsideDistance2(double x, double y, int cx, int cy, int r) const
+{
+    // Nodes outside the rings lie beyond one of the sides of the box the rings cover that has
+    // not reached the edge of the grid yet. The slack absorbs rounding in CellX and CellY.
+    double distance = std::numeric_limits<double>::infinity();
+    const double slack = m_CellSize * 1e-9;
+    if (cx - r > 0)
+        distance = std::min(distance, x - (m_MinX + (cx - r) * m_CellSize));
+    if (cx + r < m_Columns - 1)
+        distance = std::min(distance, m_MinX + (cx + r + 1) * m_CellSize - x);
+    if (cy - r > 0)
+        distance = std::min(distance, y - (m_MinY + (cy - r) * m_CellSize));
+    if (cy + r < m_Rows - 1)
+        distance = std::min(distance, m_MinY + (cy + r + 1) * m_CellSize - y);
+    if (std::isinf(distance))
+        return distance;
+    distance = std::max(distance - slack, 0.0);
+    return distance * distance;
+}
+
+int SpatialIndex::Nearest(double x, double y) const
+{
+    if (m_Ids.empty())
+        return -1;
+    const int cx = CellX(x), cy = CellY(y);
+    Candidate best{std::numeric_limits<double>::infinity(), -1};
+    for (int r = 0;; r++)
+    {
+        VisitRing(cx, cy, r, [&](int begin, int end) {
+            if (MinDistance2(begin, end, x, y) > best.distance2)
+                return;
+            for (int slot = begin; slot < end; slot++)
+            {
+                const double dx = m_X[slot] - x, dy = m_Y[slot] - y;
+                const Candidate candidate{dx * dx + dy * dy, m_Ids[slot]};
+                if (candidate < best)
+                    best = candidate;
+            }
+        });
+        const double outside = OutsideDistance2(x, y, cx, cy, r);
+        if (best.distance2 < outside || std::isinf(outside))
+            return best.id;
+    }
+}
+
+std::vector<int> SpatialIndex::KNearest(double x, double y, std::size_t k) const
+{
+    k = std::min(k, m_Ids.size());
+    if (k == 0)
+        return {};
+    const int cx = CellX(x), cy = CellY(y);
+    std::priority_queue<Candidate> best; // The farthest of the k best on top.
+    for (int r = 0;; r++)
+    {
+        VisitRing(cx, cy, r, [&](int begin, int end) {
+            if (best.size() == k && MinDistance2(begin, end, x, y) > best.top().distance2)
+                return;
+            for (int slot = begin; slot < end; slot++)
+            {
+                const double dx = m_X[slot] - x, dy = m_Y[slot] - y;
+                const Candidate candidate{dx * dx + dy * dy, m_Ids[slot]};
+                if (best.size() < k)
+                    best.push(candidate);
+                else if (candidate < best.top())
+                {
+                    best.pop();
+                    best.push(candidate);
+                }
+            }
+        });
+        const double outside = OutsideDistance2(x, y, cx, cy, r);
+        if ((best.size() == k && best.top().distance2 < outside) || std::isinf(outside))
+            break;
+    }
+    std::vector<int> ids(best.size());
+    for (auto it = ids.rbegin(); it != ids.rend(); ++it, best.pop())
+        *it = best.top().id;
+    return ids;
+}
+
+std::vector<int> SpatialIndex::Radius(double x, double y, double radius) const
+{
+    if (m_Ids.empty() || !(radius >= 0))
+        return {};
+    const double radius2 = radius * radius;
+    std::vector<Candidate> found;
+    for (int row = CellY(y - radius); row <= CellY(y + radius); row++)
+    {
+        // The cells of a row are adjacent, so their slots form one run.
+        const int begin = m_Cells[row * m_Columns + CellX(x - radius)];
+        const int end = m_Cells[row * m_Columns + CellX(x + radius) + 1];
+        if (begin == end || MinDistance2(begin, end, x, y) > radius2)
+            continue;
+        for (int slot = begin; slot < end; slot++)
+        {
+            const double dx = m_X[slot] - x, dy = m_Y[slot] - y;
+            if (dx * dx + dy * dy <= radius2)
+                found.push_back({dx * dx + dy * dy, m_Ids[slot]});
+        }
+    }
+    std::sort(found.begin(), found.end());
+    std::vector<int> ids;
+    ids.reserve(found.size());
+    for (const Candidate &candidate : found)
+        ids.push_back(candidate.id);
+    return ids;
+}
@@ -0,0 +1,66 @@
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include <vector>
+#include "distance_kernel.h"
+#include "model.h"
+
+// Uniform grid over a subset of model nodes, built once and then queried read-only from any
+// number of threads. Cells hold about kNodesPerCell nodes, so nearest-node queries touch a few
+// cells around the query point instead of every node. Distances are in model units. Runs of
+// adjacent cells are first screened with the SIMD distance kernel and only those that can hold a
+// result are scanned node by node.
+class SpatialIndex
+{
+public:
+  SpatialIndex() = default;
+  // Indexes nodes[i] for every i in members.
+  SpatialIndex(const std::vector<Model::Node> &nodes, const std::vector<int> &members);
+
+  std::size_t Size() const noexcept { return m_Ids.size(); }
+
+  // Index of the node closest to (x, y), -1 when the index is empty.
+  int Nearest(double x, double y) const;
+  // Up to k nodes closest to (x, y), nearest first.
+  std::vector<int> KNearest(double x, double y, std::size_t k) const;
+  // Nodes within radius of (x, y), nearest first.
+  std::vector<int> Radius(double x, double y, double radius) const;
+
+private:
+  static constexpr int kNodesPerCell = 4;
+
+  struct Candidate
+  {
+    double distance2;
+    int id;
+    bool operator<(const Candidate &other) const
+    {
+      return distance2 != other.distance2 ? distance2 < other.distance2 : id < other.id;
+    }
+  };
+
+  int CellX(double x) const;
+  int CellY(double y) const;
+  // Calls visit(begin, end) for runs of slots that together hold the nodes in the cells of ring
+  // r around (cx, cy).
+  template <typename F>
+  void VisitRing(int cx, int cy, int r, F &&visit) const;
+  // Smallest squared distance from (x, y) to the nodes in slots [begin, end).
+  double MinDistance2(int begin, int end, double x, double y) const
+  {
+    return m_Kernels->min_squared_distance(m_X.data() + begin, m_Y.data() + begin, end - begin, x, y);
+  }
+  // Squared distance from (x, y) to the closest node outside the rings up to r around
+  // (cx, cy); infinite once those rings cover the grid.
+  double OutsideDistance2(double x, double y, int cx, int cy, int r) const;
+
+  double m_MinX = 0, m_MinY = 0;
+  double m_CellSize = 1;
+  int m_Columns = 0, m_Rows = 0;
+  std::vector<int> m_Cells; // Node slots of cell i are [m_Cells[i], m_Cells[i + 1]).
+  std::vector<double> m_X, m_Y;
+  std::vector<int> m_Ids;   // Model node index of every slot.
+  const DistanceKernels *m_Kernels = &GetDistanceKernels();
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+ThreadPool::ThreadPool(unsigned threads)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned worker = 0; worker < threads; worker++)
+        m_Workers.emplace_back([this, worker] { WorkerLoop(worker); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stop = true;
+    }
+    m_Wake.notify_all();
+    for (auto &worker : m_Workers)
+        worker.join();
+}
+
+void ThreadPool::Submit(Task task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Tasks.push_back(std::move(task));
+    }
+    m_Wake.notify_one();
+}
+
+void ThreadPool::ParallelFor(std::size_t count, const std::function<void(std::size_t index, unsigned worker)> &body)
+{
+    if (count == 0)
+        return;
+
+    // One task per worker, each pulling indices until none are left; small bodies stay balanced
+    // without queueing a task per index.
+    std::atomic<std::size_t> next{0};
+    std::mutex done_mutex;
+    std::condition_variable done;
+    std::exception_ptr error;
+    const unsigned tasks = (unsigned)std::min<std::size_t>(Size(), count);
+    unsigned running = tasks;
+
+    for (unsigned t = 0; t < tasks; t++)
+        Submit([&](unsigned worker) {
+            for (std::size_t index; (index = next++) < count;)
+            {
+                try
+                {
+                    body(index, worker);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(done_mutex);
+                    if (!error)
+                        error = std::current_exception();
+                    next = count;
+                }
+            }
+            std::lock_guard<std::mutex> lock(done_mutex);
+            if (--running == 0)
+                done.notify_one();
+        });
+
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done.wait(lock, [&] { return running == 0; });
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void ThreadPool::WorkerLoop(unsigned worker)
+{
+    while (true)
+    {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Wake.wait(lock, [this] { return m_Stop || !m_Tasks.empty(); });
+            if (m_Tasks.empty())
+                return;
+            task = std::move(m_Tasks.front());
+            m_Tasks.pop_front();
+        }
+        task(worker);
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads fed from a FIFO queue. Tasks receive the index of the worker that
+// runs them, so callers can keep one set of scratch state per worker instead of per task.
+class ThreadPool
+{
+public:
+  using Task = std::function<void(unsigned worker)>;
+
+  // threads == 0 starts one worker per hardware thread.
+  explicit ThreadPool(unsigned threads = 0);
+  // Runs the tasks still queued, then joins the workers.
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  unsigned Size() const noexcept { return (unsigned)m_Workers.size(); }
+
+  // Queues a task; it must not throw.
+  void Submit(Task task);
+
+  // Runs body(index, worker) for every index in [0, count) and waits for all of them, rethrowing
+  // the first exception. Must not be called from a task of the same pool.
+  void ParallelFor(std::size_t count, const std::function<void(std::size_t index, unsigned worker)> &body);
+
+private:
+  void WorkerLoop(unsigned worker);
+
+  std::vector<std::thread> m_Workers;
+  std::deque<Task> m_Tasks;
+  std::mutex m_Mutex;
+  std::condition_variable m_Wake;
+  bool m_Stop = false;
+};
+
+#endif
@@ -0,0 +1,254 @@
+#include "xml_stream.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+static bool IsSpace(char c) noexcept
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Attribute values containing any of these characters are normalized by DecodeAttribute.
+static bool NeedsDecoding(std::string_view value) noexcept
+{
+    for( auto c: value )
+        if( (unsigned char)c <= '&' && (c == '&' || c == '\t' || c == '\n' || c == '\r') )
+            return true;
+    return false;
+}
+
+static void AppendUtf8(std::string &out, unsigned long code)
+{
+    if( code < 0x80 )
+        out += (char)code;
+    else if( code < 0x800 ) {
+        out += (char)(0xC0 | (code >> 6));
+        out += (char)(0x80 | (code & 0x3F));
+    }
+    else if( code < 0x10000 ) {
+        out += (char)(0xE0 | (code >> 12));
+        out += (char)(0x80 | ((code >> 6) & 0x3F));
+        out += (char)(0x80 | (code & 0x3F));
+    }
+    else {
+        out += (char)(0xF0 | (code >> 18));
+        out += (char)(0x80 | ((code >> 12) & 0x3F));
+        out += (char)(0x80 | ((code >> 6) & 0x3F));
+        out += (char)(0x80 | (code & 0x3F));
+    }
+}
+
+// Expands character references and converts whitespace to spaces, as a conforming parser does
+// for attribute values. Unknown entities are kept verbatim.
+static void DecodeAttribute(std::string_view raw, std::string &out)
+{
+    out.clear();
+    for( std::size_t i = 0; i < raw.size(); ++i ) {
+        const auto c = raw[i];
+        if( c == '\r' ) {
+            out += ' ';
+            if( i + 1 < raw.size() && raw[i + 1] == '\n' )
+                ++i;
+            continue;
+        }
+        if( c == '\n' || c == '\t' ) {
+            out += ' ';
+            continue;
+        }
+        if( c != '&' ) {
+            out += c;
+            continue;
+        }
+        const auto semicolon = raw.find(';', i);
+        if( semicolon == std::string_view::npos ) {
+            out += c;
+            continue;
+        }
+        const auto entity = raw.substr(i + 1, semicolon - i - 1);
+        if( entity == "lt" )        out += '<';
+        else if( entity == "gt" )   out += '>';
+        else if( entity == "amp" )  out += '&';
+        else if( entity == "quot" ) out += '"';
+        else if( entity == "apos" ) out += '\'';
+        else if( entity.size() > 1 && entity[0] == '#' ) {
+            const auto hex = entity[1] == 'x';
+            const auto digits = std::string{entity.substr(hex ? 2 : 1)};
+            char *digits_end = nullptr;
+            const auto code = std::strtoul(digits.c_str(), &digits_end, hex ? 16 : 10);
+            if( digits.empty() || *digits_end != '\0' || code > 0x10FFFF ) {
+                out += c;
+                continue;
+            }
+            AppendUtf8(out, code);
+        }
+        else {
+            out += c;
+            continue;
+        }
+        i = semicolon;
+    }
+}
+
+void XmlStreamParser::Feed(const char *data, std::size_t size)
+{
+    if( m_Pending.empty() ) {
+        const auto used = Parse(data, data + size);
+        m_Pending.assign(data + used, data + size);
+    }
+    else {
+        m_Pending.append(data, size);
+        const auto used = Parse(m_Pending.data(), m_Pending.data() + m_Pending.size());
+        m_Pending.erase(0, used);
+    }
+}
+
+void XmlStreamParser::Finish()
+{
+    if( std::any_of(m_Pending.begin(), m_Pending.end(), [](char c){ return !IsSpace(c); }) )
+        throw std::logic_error("failed to parse the xml file");
+    m_Pending.clear();
+}
+
+std::string_view XmlStreamParser::Find(const std::vector<Attribute> &attributes, std::string_view name) noexcept
+{
+    for( auto &attribute: attributes )
+        if( attribute.name == name )
+            return attribute.value;
+    return {};
+}
+
+// Reports every complete tag in [begin, end) and returns how many bytes were consumed; the rest
+// is an incomplete tag which is retried once more data arrives.
+std::size_t XmlStreamParser::Parse(const char *begin, const char *end)
+{
+    auto p = begin;
+    while( true ) {
+        auto lt = static_cast<const char*>(std::memchr(p, '<', end - p));
+        if( !lt )
+            return end - begin;
+        const auto incomplete = lt - begin;
+        const auto rest = std::string_view(lt, end - lt);
+        auto skip_to = [&](std::string_view terminator, std::size_t from) -> bool {
+            const auto pos = rest.find(terminator, from);
+            if( pos == std::string_view::npos )
+                return false;
+            p = lt + pos + terminator.size();
+            return true;
+        };
+        
+        if( rest.size() < 2 )
+            return incomplete;
+        if( rest[1] == '?' ) {
+            if( !skip_to("?>", 2) )
+                return incomplete;
+        }
+        else if( rest[1] == '!' ) {
+            if( rest.size() < 9 && rest.substr(0, 4) != "<!--" )
+                return incomplete;
+            if( rest.substr(0, 4) == "<!--" ) {
+                if( !skip_to("-->", 4) )
+                    return incomplete;
+            }
+            else if( rest.substr(0, 9) == "<![CDATA[" ) {
+                if( !skip_to("]]>", 9) )
+                    return incomplete;
+            }
+            else if( !skip_to(">", 2) )
+                return incomplete;
+        }
+        else if( rest[1] == '/' ) {
+            const auto gt = rest.find('>', 2);
+            if( gt == std::string_view::npos )
+                return incomplete;
+            auto name = rest.substr(2, gt - 2);
+            while( !name.empty() && IsSpace(name.back()) )
+                name.remove_suffix(1);
+            m_Handler.EndElement(name);
+            p = lt + gt + 1;
+        }
+        else {
+            auto tag_end = ParseStartTag(lt + 1, end);
+            if( !tag_end )
+                return incomplete;
+            p = tag_end;
+        }
+    }
+}
+
+// Parses the tag starting after '<' and reports it, returns the position past its closing '>' or
+// nullptr when the tag does not end within [begin, end). Attribute values are skipped as a whole
+// since they may legally contain '>'.
+const char *XmlStreamParser::ParseStartTag(const char *begin, const char *end)
+{
+    auto fail = []{ throw std::logic_error("failed to parse the xml file"); };
+    
+    auto p = begin;
+    while( p != end && !IsSpace(*p) && *p != '/' && *p != '>' )
+        ++p;
+    const auto name = std::string_view(begin, p - begin);
+    
+    m_Attributes.clear();
+    auto needs_decoding = false;
+    auto self_closing = false;
+    while( true ) {
+        while( p != end && IsSpace(*p) )
+            ++p;
+        if( p == end )
+            return nullptr;
+        if( *p == '>' )
+            break;
+        if( *p == '/' ) {
+            if( ++p == end )
+                return nullptr;
+            if( *p != '>' )
+                fail();
+            self_closing = true;
+            break;
+        }
+        const auto attr_begin = p;
+        while( p != end && *p != '=' && !IsSpace(*p) && *p != '>' )
+            ++p;
+        const auto attr_name = std::string_view(attr_begin, p - attr_begin);
+        while( p != end && IsSpace(*p) )
+            ++p;
+        if( p == end )
+            return nullptr;
+        if( *p != '=' )
+            fail();
+        ++p;
+        while( p != end && IsSpace(*p) )
+            ++p;
+        if( p == end )
+            return nullptr;
+        if( *p != '"' && *p != '\'' )
+            fail();
+        const auto quote = *p++;
+        const auto value_end = static_cast<const char*>(std::memchr(p, quote, end - p));
+        if( !value_end )
+            return nullptr;
+        const auto value = std::string_view(p, value_end - p);
+        p = value_end + 1;
+        needs_decoding = needs_decoding || NeedsDecoding(value);
+        m_Attributes.push_back({attr_name, value});
+    }
+    if( name.empty() )
+        fail();
+    
+    if( needs_decoding ) {
+        if( m_Decoded.size() < m_Attributes.size() )
+            m_Decoded.resize(m_Attributes.size());
+        for( std::size_t i = 0; i < m_Attributes.size(); ++i ) {
+            auto &value = m_Attributes[i].value;
+            if( !NeedsDecoding(value) )
+                continue;
+            DecodeAttribute(value, m_Decoded[i]);
+            value = m_Decoded[i];
+        }
+    }
+    
+    m_Handler.StartElement(name, m_Attributes);
+    if( self_closing )
+        m_Handler.EndElement(name);
+    return p + 1;
+}
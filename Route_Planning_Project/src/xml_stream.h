@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Incremental, non-validating XML reader. Input is fed in arbitrary chunks and element events are
+// reported as soon as a tag is complete, so memory use is bounded by the longest tag rather than
+// the document. Text content, comments, processing instructions and doctypes are skipped, which
+// is all OSM data needs: everything of interest lives in attributes.
+class XmlStreamParser
+{
+public:
+    struct Attribute {
+        std::string_view name;
+        std::string_view value;
+    };
+    
+    class Handler
+    {
+    public:
+        virtual ~Handler() = default;
+        virtual void StartElement(std::string_view name, const std::vector<Attribute> &attributes) = 0;
+        virtual void EndElement(std::string_view name) = 0;
+    };
+    
+    explicit XmlStreamParser( Handler &handler ): m_Handler(handler) {}
+    
+    // Throws std::logic_error on malformed input.
+    void Feed(const char *data, std::size_t size);
+    // Signals the end of input, throws std::logic_error if a tag was left incomplete.
+    void Finish();
+    
+    // Value of the attribute with the given name, or an empty view.
+    static std::string_view Find(const std::vector<Attribute> &attributes, std::string_view name) noexcept;
+    
+private:
+    std::size_t Parse(const char *begin, const char *end);
+    const char *ParseStartTag(const char *begin, const char *end);
+    
+    Handler &m_Handler;
+    std::string m_Pending;
+    std::vector<Attribute> m_Attributes;
+    std::vector<std::string> m_Decoded;
+};
@@ -0,0 +1,16 @@
+#include "allocation_counter.h"
+#include <cstdlib>
+#include <new>
+
+std::atomic<std::size_t> g_Allocations{0};
+
+void *operator new(std::size_t size)
+{
+    ++g_Allocations;
+    if( void *p = std::malloc(size ? size : 1) )
+        return p;
+    throw std::bad_alloc{};
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Heap allocations made by the process, counted by the operator new replacement in
+// allocation_counter.cpp. The replacement lives in a translation unit of its own so that no
+// allocation site sees it inlined next to a call to free.
+extern std::atomic<std::size_t> g_Allocations;
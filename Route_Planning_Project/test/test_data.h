@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../src/route_model.h"
+#include "../src/routing_profile.h"
+
+inline std::optional<std::vector<std::byte>> ReadFile(const std::string &path)
+{   
+    std::ifstream is{path, std::ios::binary | std::ios::ate};
+    if( !is )
+        return std::nullopt;
+    
+    auto size = is.tellg();
+    std::vector<std::byte> contents(size);    
+    
+    is.seekg(0);
+    is.read((char*)contents.data(), size);
+
+    if( contents.empty() )
+        return std::nullopt;
+    return contents;
+}
+
+inline std::vector<std::byte> ReadOSMData(const std::string &path) {
+    std::vector<std::byte> osm_data;
+    auto data = ReadFile(path);
+    if( !data ) {
+        std::cout << "Failed to read OSM data." << std::endl;
+    } else {
+        osm_data = std::move(*data);
+    }
+    return osm_data;
+}
+
+// Seeded random node indices of the model, the same on every run for a given seed. With on_roads
+// only nodes on roads of the distance profile are picked, so that most pairs of them connect.
+inline std::vector<int> RandomNodes(const RouteModel &model, int count, unsigned seed, bool on_roads = false) {
+    std::vector<int> candidates;
+    if( on_roads ) {
+        const auto &graph = model.RoadGraph();
+        for( std::size_t i = 0; i + 1 < graph.offsets.size(); ++i )
+            if( std::any_of(graph.types.begin() + graph.offsets[i], graph.types.begin() + graph.offsets[i + 1], DistanceProfile::Allows) )
+                candidates.push_back(static_cast<int>(i));
+    }
+    std::mt19937 rng{seed};
+    std::uniform_int_distribution<int> pick{0, static_cast<int>((on_roads ? candidates.size() : model.SNodes().size()) - 1)};
+    std::vector<int> nodes;
+    for( int i = 0; i < count; ++i )
+        nodes.push_back(on_roads ? candidates[pick(rng)] : pick(rng));
+    return nodes;
+}
+
+// Seeded random pairs of nodes, start and goal of a query each, picked as RandomNodes does.
+inline std::vector<std::pair<int, int>> RandomQueries(const RouteModel &model, int count, unsigned seed, bool on_roads = false) {
+    const auto nodes = RandomNodes(model, 2 * count, seed, on_roads);
+    std::vector<std::pair<int, int>> queries;
+    for( int i = 0; i < count; ++i )
+        queries.push_back({nodes[2 * i], nodes[2 * i + 1]});
+    return queries;
+}
@@ -1,40 +1,18 @@
 #include "gtest/gtest.h"
+#include <algorithm>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <optional>
+#include <queue>
 #include <vector>
+#include "../src/open_list.h"
 #include "../src/route_model.h"
 #include "../src/route_planner.h"
+#include "test_data.h"
 
 
-static std::optional<std::vector<std::byte>> ReadFile(const std::string &path)
-{   
-    std::ifstream is{path, std::ios::binary | std::ios::ate};
-    if( !is )
-        return std::nullopt;
-    
-    auto size = is.tellg();
-    std::vector<std::byte> contents(size);    
-    
-    is.seekg(0);
-    is.read((char*)contents.data(), size);
-
-    if( contents.empty() )
-        return std::nullopt;
-    return std::move(contents);
-}
-
-std::vector<std::byte> ReadOSMData(const std::string &path) {
-    std::vector<std::byte> osm_data;
-    auto data = ReadFile(path);
-    if( !data ) {
-        std::cout << "Failed to read OSM data." << std::endl;
-    } else {
-        osm_data = std::move(*data);
-    }
-    return osm_data;
-}
-
 //--------------------------------//
 //   Beginning RoutePlanner Tests.
 //--------------------------------//
@@ -44,49 +22,53 @@ class RoutePlannerTest : public ::testing::Test {
     std::string osm_data_file = "../map.osm";
     std::vector<std::byte> osm_data = ReadOSMData(osm_data_file);
     RouteModel model{osm_data};
-    RoutePlanner route_planner{model, 10, 10, 90, 90};
+    RoutePlanner route_planner{model};
     
     // Construct start_node and end_node as in the model.
     float start_x = 0.1;
     float start_y = 0.1;
     float end_x = 0.9;
     float end_y = 0.9;
-    RouteModel::Node* start_node = &model.FindClosestNode(start_x, start_y);
-    RouteModel::Node* end_node = &model.FindClosestNode(end_x, end_y);
+    const RouteModel::Node* start_node = &model.FindClosestNode(start_x, start_y);
+    const RouteModel::Node* end_node = &model.FindClosestNode(end_x, end_y);
 
     // Construct another node in the middle of the map for testing.
     float mid_x = 0.5;
     float mid_y = 0.5;
-    RouteModel::Node* mid_node = &model.FindClosestNode(mid_x, mid_y);
+    const RouteModel::Node* mid_node = &model.FindClosestNode(mid_x, mid_y);
+
+    void SetUp() override { route_planner.StartSearch(start_node->Index(), end_node->Index()); }
 };
 
 
 // Test the CalculateHValue method.
 TEST_F(RoutePlannerTest, TestCalculateHValue) {
-    EXPECT_FLOAT_EQ(route_planner.CalculateHValue(start_node), 1.1329799);
-    EXPECT_FLOAT_EQ(route_planner.CalculateHValue(end_node), 0.0f);
-    EXPECT_FLOAT_EQ(route_planner.CalculateHValue(mid_node), 0.58903033);
+    EXPECT_FLOAT_EQ(route_planner.CalculateHValue(start_node->Index()), 1.1329799);
+    EXPECT_FLOAT_EQ(route_planner.CalculateHValue(end_node->Index()), 0.0f);
+    EXPECT_FLOAT_EQ(route_planner.CalculateHValue(mid_node->Index()), 0.58903033);
 }
 
 
 
 // Test the AddNeighbors method.
-bool NodesSame(RouteModel::Node* a, RouteModel::Node* b) { return a == b; }
 TEST_F(RoutePlannerTest, TestAddNeighbors) {
-    route_planner.AddNeighbors(start_node);
-
-    // Correct h and g values for the neighbors of start_node.
-    std::vector<float> start_neighbor_g_vals{0.10671431, 0.082997195, 0.051776856, 0.055291083};
-    std::vector<float> start_neighbor_h_vals{1.1828455, 1.0998145, 1.0858033, 1.1831238};
-    auto neighbors = start_node->neighbors;
+    route_planner.AddNeighbors(start_node->Index());
+
+    // Correct h and g values for the neighbors of start_node, in road graph order.
+    std::vector<float> start_neighbor_g_vals{0.10671431, 0.055291083, 0.051776856, 0.082997195};
+    std::vector<float> start_neighbor_h_vals{1.1828455, 1.1831238, 1.0858033, 1.0998145};
+    const auto &graph = model.RoadGraph();
+    std::vector<int> neighbors(graph.targets.begin() + graph.offsets[start_node->Index()],
+                               graph.targets.begin() + graph.offsets[start_node->Index() + 1]);
     EXPECT_EQ(neighbors.size(), 4);
 
     // Check results for each neighbor.
+    const auto &workspace = route_planner.Workspace();
     for (int i = 0; i < neighbors.size(); i++) {
-        EXPECT_PRED2(NodesSame, neighbors[i]->parent, start_node);
-        EXPECT_FLOAT_EQ(neighbors[i]->g_value, start_neighbor_g_vals[i]);
-        EXPECT_FLOAT_EQ(neighbors[i]->h_value, start_neighbor_h_vals[i]);
-        EXPECT_EQ(neighbors[i]->visited, true);
+        EXPECT_EQ(workspace.Parent(neighbors[i]), start_node->Index());
+        EXPECT_FLOAT_EQ(workspace.G(neighbors[i]), start_neighbor_g_vals[i]);
+        EXPECT_FLOAT_EQ(workspace.H(neighbors[i]), start_neighbor_h_vals[i]);
+        EXPECT_EQ(workspace.Visited(neighbors[i]), true);
     }
 }
 
@@ -94,9 +76,11 @@ TEST_F(RoutePlannerTest, TestAddNeighbors) {
 // Test the ConstructFinalPath method.
 TEST_F(RoutePlannerTest, TestConstructFinalPath) {
     // Construct a path.
-    mid_node->parent = start_node;
-    end_node->parent = mid_node;
-    std::vector<RouteModel::Node> path = route_planner.ConstructFinalPath(end_node);
+    auto &workspace = route_planner.Workspace();
+    workspace.Visit(mid_node->Index(), start_node->Index(), 0.0f, 0.0f);
+    workspace.Visit(end_node->Index(), mid_node->Index(), 0.0f, 0.0f);
+    std::vector<int> indices = route_planner.ConstructFinalPath(end_node->Index());
+    auto path = model.PathNodes(indices);
 
     // Test the path.
     EXPECT_EQ(path.size(), 3);
@@ -109,14 +93,140 @@ TEST_F(RoutePlannerTest, TestConstructFinalPath) {
 
 // Test the AStarSearch method.
 TEST_F(RoutePlannerTest, TestAStarSearch) {
-    route_planner.AStarSearch();
-    EXPECT_EQ(model.path.size(), 33);
-    RouteModel::Node path_start = model.path.front();
-    RouteModel::Node path_end = model.path.back();
+    auto route = route_planner.Route(10, 10, 90, 90);
+    EXPECT_EQ(route.path.size(), 70);
+    const RouteModel::Node &path_start = model.PathNodes(route.path).front();
+    const RouteModel::Node &path_end = model.PathNodes(route.path).back();
     // The start_node and end_node x, y values should be the same as in the path.
     EXPECT_FLOAT_EQ(start_node->x, path_start.x);
     EXPECT_FLOAT_EQ(start_node->y, path_start.y);
     EXPECT_FLOAT_EQ(end_node->x, path_end.x);
     EXPECT_FLOAT_EQ(end_node->y, path_end.y);
-    EXPECT_FLOAT_EQ(route_planner.GetDistance(), 873.41565);
+    EXPECT_FLOAT_EQ(route.distance, 839.26294);
+}
+
+
+// Renumbering the nodes in Hilbert order changes indices only, not routes.
+TEST_F(RoutePlannerTest, TestReorderedNodes) {
+    ModelOptions options;
+    options.reorder_nodes = true;
+    RouteModel reordered{osm_data, options};
+    RoutePlanner planner{reordered};
+    auto route = planner.Route(10, 10, 90, 90);
+    EXPECT_EQ(route.path.size(), 70);
+    EXPECT_FLOAT_EQ(route.distance, 839.26294);
+}
+
+
+// A planner answers repeated queries on the same model without leaking state between them.
+TEST_F(RoutePlannerTest, TestRepeatedQueries) {
+    const RouteModel &shared_model = model;
+    RoutePlanner planner{shared_model};
+    auto first = planner.Route(start_node->Index(), end_node->Index());
+    auto other = planner.Route(mid_node->Index(), start_node->Index());
+    auto again = planner.Route(start_node->Index(), end_node->Index());
+    EXPECT_GT(other.distance, 0.0f);
+    EXPECT_EQ(first.path.size(), again.path.size());
+    EXPECT_FLOAT_EQ(first.distance, again.distance);
+    EXPECT_FLOAT_EQ(first.distance, 839.26294);
+
+    auto empty = planner.Route(start_node->Index(), start_node->Index());
+    EXPECT_EQ(empty.path.size(), 1);
+    EXPECT_FLOAT_EQ(empty.distance, 0.0f);
+}
+
+
+// The open list pops nodes by key, lowers keys in place and can be reused.
+TEST(OpenListTest, TestOrderAndDecreaseKey) {
+    OpenList open;
+    open.Reset(10);
+    const std::vector<float> keys{5.0f, 3.0f, 8.0f, 1.0f, 9.0f, 4.0f, 7.0f};
+    for (int node = 0; node < (int)keys.size(); node++)
+        open.Push(node, keys[node]);
+    open.DecreaseKey(4, 2.0f);
+    open.DecreaseKey(2, 0.5f);
+    EXPECT_EQ(open.Size(), keys.size());
+    EXPECT_TRUE(open.Contains(4));
+    EXPECT_FLOAT_EQ(open.Key(4), 2.0f);
+
+    std::vector<int> order;
+    while (!open.Empty())
+        order.push_back(open.Pop());
+    EXPECT_EQ(order, (std::vector<int>{2, 3, 4, 1, 5, 0, 6}));
+    EXPECT_FALSE(open.Contains(2));
+
+    open.Push(7, 1.0f);
+    open.Push(8, 0.0f);
+    open.Reset(10);
+    EXPECT_TRUE(open.Empty());
+    EXPECT_FALSE(open.Contains(7));
+    EXPECT_FALSE(open.Contains(8));
+}
+
+
+// A* with decrease-key finds the same distances as a plain Dijkstra search over the non-footway
+// roads and expands every node at most once.
+TEST_F(RoutePlannerTest, TestOptimalDistances) {
+    const auto &graph = model.RoadGraph();
+    const int count = model.SNodes().size();
+    auto dijkstra = [&](int start, int goal) -> float {
+        std::vector<float> dist(count, std::numeric_limits<float>::max());
+        using Entry = std::pair<float, int>;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+        dist[start] = 0.0f;
+        queue.push({0.0f, start});
+        while (!queue.empty()) {
+            auto [d, node] = queue.top();
+            queue.pop();
+            if (node == goal)
+                return d * model.MetricScale();
+            if (d > dist[node])
+                continue;
+            for (int edge = graph.offsets[node]; edge < graph.offsets[node + 1]; edge++) {
+                const int next = graph.targets[edge];
+                if (DistanceProfile::Allows(graph.types[edge]) && d + graph.lengths[edge] < dist[next]) {
+                    dist[next] = d + graph.lengths[edge];
+                    queue.push({dist[next], next});
+                }
+            }
+        }
+        return -1.0f;
+    };
+
+    for (auto [start, goal] : RandomQueries(model, 50, 7)) {
+        auto route = route_planner.Route(start, goal);
+        const float expected = dijkstra(start, goal);
+        if (expected < 0.0f) {
+            EXPECT_TRUE(route.path.empty());
+            continue;
+        }
+        EXPECT_NEAR(route.distance, expected, expected * 1e-4f + 1e-3f);
+        EXPECT_LE(route.stats.expanded, route.stats.pushed);
+    }
+}
+
+
+// Bidirectional search finds routes as short as the forward search, made of road segments.
+TEST_F(RoutePlannerTest, TestBidirectionalSearch) {
+    const auto &graph = model.RoadGraph();
+    auto queries = RandomQueries(model, 200, 13);
+    queries.front().second = queries.front().first; // A route from a node to itself.
+    for (auto [start, goal] : queries) {
+        auto forward = route_planner.Route(start, goal);
+        auto both = route_planner.Route(start, goal, RoutePlanner::Search::Bidirectional);
+        ASSERT_EQ(both.path.empty(), forward.path.empty());
+        if (both.path.empty())
+            continue;
+        EXPECT_NEAR(both.distance, forward.distance, forward.distance * 1e-4f + 1e-3f);
+        EXPECT_EQ(both.path.front(), start);
+        EXPECT_EQ(both.path.back(), goal);
+        for (size_t j = 1; j < both.path.size(); j++) {
+            auto first = graph.targets.begin() + graph.offsets[both.path[j - 1]];
+            auto last = graph.targets.begin() + graph.offsets[both.path[j - 1] + 1];
+            EXPECT_NE(std::find(first, last, both.path[j]), last);
+        }
+    }
+
+    auto route = route_planner.Route(10, 10, 90, 90, RoutePlanner::Search::Bidirectional);
+    EXPECT_FLOAT_EQ(route.distance, 839.26294);
 }
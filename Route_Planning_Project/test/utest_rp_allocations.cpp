@@ -0,0 +1,61 @@
+#include "gtest/gtest.h"
+#include <vector>
+#include "../src/route_model.h"
+#include "../src/route_planner.h"
+#include "allocation_counter.h"
+#include "test_data.h"
+
+//--------------------------------//
+//   Beginning Allocation Tests.
+//--------------------------------//
+
+class AllocationTest : public ::testing::Test {
+  protected:
+    std::vector<std::byte> osm_data = ReadOSMData("../map.osm");
+    RouteModel model{osm_data};
+    RoutePlanner planner{model};
+    std::vector<std::pair<int, int>> queries;
+
+    void SetUp() override {
+        queries = RandomQueries(model, 100, 5);
+        // Warm up: the planner's workspace and open list grow to the largest search once.
+        for (auto [start, goal] : queries) {
+            planner.StartSearch(start, goal);
+            planner.AStarSearch();
+            planner.StartBidirectionalSearch(start, goal);
+            planner.BidirectionalSearch();
+        }
+    }
+};
+
+
+// Once warmed up, searching never touches the heap, however many nodes it expands.
+TEST_F(AllocationTest, TestSearchIsAllocationFree) {
+    long expanded = 0;
+    for (auto [start, goal] : queries) {
+        const auto before = g_Allocations.load();
+        planner.StartSearch(start, goal);
+        planner.AStarSearch();
+        planner.StartBidirectionalSearch(start, goal);
+        planner.BidirectionalSearch();
+        const auto allocations = g_Allocations.load() - before;
+        EXPECT_EQ(allocations, 0);
+        expanded += planner.Route(start, goal).stats.expanded;
+    }
+    EXPECT_GT(expanded, 1000);
+}
+
+
+// A whole query allocates only the returned path, and viewing it as nodes allocates nothing.
+TEST_F(AllocationTest, TestRouteAllocatesOnlyThePath) {
+    for (auto [start, goal] : queries) {
+        const auto before = g_Allocations.load();
+        auto route = planner.Route(start, goal);
+        size_t visited = 0;
+        for (const RouteModel::Node &node : model.PathNodes(route.path))
+            visited += node.Index() == route.path[visited];
+        const auto allocations = g_Allocations.load() - before;
+        EXPECT_EQ(allocations, route.path.empty() ? 0 : 1);
+        EXPECT_EQ(visited, route.path.size());
+    }
+}
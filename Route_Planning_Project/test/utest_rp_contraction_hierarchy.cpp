@@ -0,0 +1,118 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include "../src/contraction_hierarchy.h"
+#include "../src/route_model.h"
+#include "../src/route_planner.h"
+#include "test_data.h"
+
+//--------------------------------------//
+//   Beginning ContractionHierarchy Tests.
+//--------------------------------------//
+
+class ContractionHierarchyTest : public ::testing::Test {
+  protected:
+    std::vector<std::byte> osm_data = ReadOSMData("../map.osm");
+    RouteModel model{osm_data};
+    std::string hierarchy_file = "utest_hierarchy.ch";
+
+    void TearDown() override {
+        std::remove(hierarchy_file.c_str());
+    }
+};
+
+
+// Hierarchy queries find routes as short as A*, made of road segments of the original graph.
+TEST_F(ContractionHierarchyTest, TestMatchesAStar) {
+    ASSERT_TRUE(model.BuildHierarchy());
+    ASSERT_NE(model.Hierarchy(), nullptr);
+    EXPECT_GT(model.Hierarchy()->Shortcuts(), 0);
+
+    const auto &graph = model.RoadGraph();
+    RoutePlanner planner{model};
+    for (auto [start, goal] : RandomQueries(model, 300, 17)) {
+        auto forward = planner.Route(start, goal);
+        auto hierarchy = planner.Route(start, goal, RoutePlanner::Search::Hierarchy);
+        ASSERT_EQ(hierarchy.path.empty(), forward.path.empty());
+        if (hierarchy.path.empty())
+            continue;
+        EXPECT_NEAR(hierarchy.distance, forward.distance, forward.distance * 1e-4f + 1e-3f);
+        EXPECT_EQ(hierarchy.path.front(), start);
+        EXPECT_EQ(hierarchy.path.back(), goal);
+        for (size_t i = 1; i < hierarchy.path.size(); i++) {
+            auto first = graph.targets.begin() + graph.offsets[hierarchy.path[i - 1]];
+            auto last = graph.targets.begin() + graph.offsets[hierarchy.path[i - 1] + 1];
+            EXPECT_NE(std::find(first, last, hierarchy.path[i]), last);
+        }
+    }
+}
+
+
+// Without a hierarchy, hierarchy queries fall back to A*.
+TEST_F(ContractionHierarchyTest, TestFallback) {
+    EXPECT_EQ(model.Hierarchy(), nullptr);
+    EXPECT_FALSE(model.LoadHierarchy(hierarchy_file));
+    RoutePlanner planner{model};
+    for (auto [start, goal] : RandomQueries(model, 20, 19)) {
+        auto forward = planner.Route(start, goal);
+        auto hierarchy = planner.Route(start, goal, RoutePlanner::Search::Hierarchy);
+        EXPECT_EQ(hierarchy.path, forward.path);
+        EXPECT_EQ(hierarchy.stats.expanded, forward.stats.expanded);
+    }
+}
+
+
+// A stored hierarchy loads into another model of the same map and answers the same routes.
+TEST_F(ContractionHierarchyTest, TestSaveAndLoad) {
+    ASSERT_TRUE(model.BuildHierarchy(hierarchy_file));
+    RouteModel loaded_model{osm_data};
+    ASSERT_TRUE(loaded_model.LoadHierarchy(hierarchy_file));
+    EXPECT_EQ(loaded_model.Hierarchy()->Ranks(), model.Hierarchy()->Ranks());
+    EXPECT_EQ(loaded_model.Hierarchy()->Upward().targets, model.Hierarchy()->Upward().targets);
+    EXPECT_EQ(loaded_model.Hierarchy()->Upward().middles, model.Hierarchy()->Upward().middles);
+
+    RoutePlanner planner{model}, loaded_planner{loaded_model};
+    for (auto [start, goal] : RandomQueries(model, 50, 23)) {
+        auto expected = planner.Route(start, goal, RoutePlanner::Search::Hierarchy);
+        auto route = loaded_planner.Route(start, goal, RoutePlanner::Search::Hierarchy);
+        EXPECT_EQ(route.path, expected.path);
+    }
+}
+
+
+// Damaged hierarchy files are rejected and leave the model's hierarchy alone.
+TEST_F(ContractionHierarchyTest, TestRejectsDamagedFile) {
+    ASSERT_TRUE(model.BuildHierarchy(hierarchy_file));
+    auto data = *ReadFile(hierarchy_file);
+
+    auto write = [&](const std::vector<std::byte> &bytes) {
+        std::ofstream os{hierarchy_file, std::ios::binary | std::ios::trunc};
+        os.write((const char *)bytes.data(), bytes.size());
+    };
+    RouteModel other{osm_data};
+    write({data.begin(), data.begin() + data.size() / 2});
+    EXPECT_FALSE(other.LoadHierarchy(hierarchy_file));
+
+    // Point the first upward edge back at its own node. The file is a 32 byte header, then
+    // count-prefixed ranks, offsets and targets, each padded to 8 bytes.
+    const auto &upward = model.Hierarchy()->Upward();
+    auto node = std::upper_bound(upward.offsets.begin(), upward.offsets.end(), 0) - upward.offsets.begin() - 1;
+    auto padded = [](size_t bytes) { return (bytes + 7) & ~size_t{7}; };
+    const size_t nodes = model.SNodes().size();
+    const size_t first_target = 32 + 8 + padded(nodes * 4) + 8 + padded((nodes + 1) * 4) + 8;
+    int target;
+    std::memcpy(&target, data.data() + first_target, sizeof(int));
+    ASSERT_EQ(target, upward.targets[0]);
+    auto broken = data;
+    const int self = (int)node;
+    std::memcpy(broken.data() + first_target, &self, sizeof(int));
+    write(broken);
+    EXPECT_FALSE(other.LoadHierarchy(hierarchy_file));
+    EXPECT_EQ(other.Hierarchy(), nullptr);
+
+    write(data);
+    EXPECT_TRUE(other.LoadHierarchy(hierarchy_file));
+}
@@ -0,0 +1,72 @@
+#include "gtest/gtest.h"
+#include <cmath>
+#include <random>
+#include <vector>
+#include "../src/distance_kernel.h"
+#include "../src/model.h"
+
+//--------------------------------//
+//   Beginning DistanceKernel Tests.
+//--------------------------------//
+
+class DistanceKernelTest : public ::testing::Test {
+  protected:
+    static constexpr int kCount = 1001; // Not a multiple of any vector width, to cover the tails.
+    std::vector<double> xs, ys;
+    std::vector<float> float_xs, float_ys;
+    std::vector<Model::Node> nodes;
+    std::vector<int> ids;
+
+    void SetUp() override {
+        std::mt19937 rng{21};
+        std::uniform_real_distribution<double> coordinate{0.0, 1.0};
+        std::uniform_int_distribution<int> pick{0, kCount - 1};
+        for (int i = 0; i < kCount; i++) {
+            xs.push_back(coordinate(rng));
+            ys.push_back(coordinate(rng));
+            float_xs.push_back(xs.back());
+            float_ys.push_back(ys.back());
+            nodes.push_back({xs.back(), ys.back()});
+            ids.push_back(pick(rng));
+        }
+    }
+};
+
+
+// Every level the host supports gives the scalar results, for every length up to a few vectors.
+TEST_F(DistanceKernelTest, TestLevelsAgree) {
+    const auto &scalar = GetDistanceKernels(SimdLevel::Scalar);
+    EXPECT_EQ(scalar.level, SimdLevel::Scalar);
+    for (auto level : {SimdLevel::SSE2, SimdLevel::AVX2}) {
+        const auto &kernels = GetDistanceKernels(level);
+        EXPECT_LE(kernels.level, level);
+        EXPECT_LE(kernels.level, HostSimdLevel());
+        for (std::size_t count : {0, 1, 2, 3, 5, 8, 13, 17, kCount}) {
+            EXPECT_EQ(kernels.min_squared_distance(xs.data(), ys.data(), count, 0.3, 0.6),
+                      scalar.min_squared_distance(xs.data(), ys.data(), count, 0.3, 0.6));
+
+            std::vector<float> expected(count), actual(count);
+            scalar.gather_distances(float_xs.data(), float_ys.data(), ids.data(), count, 0.3f, 0.6f, expected.data());
+            kernels.gather_distances(float_xs.data(), float_ys.data(), ids.data(), count, 0.3f, 0.6f, actual.data());
+            for (std::size_t i = 0; i < count; i++)
+                EXPECT_FLOAT_EQ(actual[i], expected[i]);
+
+            const double length = scalar.path_length(nodes.data(), ids.data(), count);
+            EXPECT_NEAR(kernels.path_length(nodes.data(), ids.data(), count), length, length * 1e-12);
+        }
+    }
+}
+
+
+// The scalar kernels compute plain straight-line distances.
+TEST_F(DistanceKernelTest, TestScalarValues) {
+    const auto &scalar = GetDistanceKernels(SimdLevel::Scalar);
+    EXPECT_TRUE(std::isinf(scalar.min_squared_distance(xs.data(), ys.data(), 0, 0.0, 0.0)));
+    const std::vector<Model::Node> square{{0, 0}, {3, 0}, {3, 4}, {0, 4}};
+    const std::vector<int> path{0, 1, 2, 3, 0};
+    EXPECT_DOUBLE_EQ(scalar.path_length(square.data(), path.data(), path.size()), 14.0);
+    const std::vector<float> sx{0, 3, 3, 0}, sy{0, 0, 4, 4};
+    std::vector<float> out(4);
+    scalar.gather_distances(sx.data(), sy.data(), path.data(), 4, 0.0f, 0.0f, out.data());
+    EXPECT_EQ(out, (std::vector<float>{0, 3, 5, 4}));
+}
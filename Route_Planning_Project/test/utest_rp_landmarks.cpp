@@ -0,0 +1,83 @@
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <fstream>
+#include <vector>
+#include "../src/landmark_table.h"
+#include "../src/route_model.h"
+#include "../src/route_planner.h"
+#include "test_data.h"
+
+//--------------------------------//
+//   Beginning LandmarkTable Tests.
+//--------------------------------//
+
+class LandmarkTableTest : public ::testing::Test {
+  protected:
+    std::vector<std::byte> osm_data = ReadOSMData("../map.osm");
+    RouteModel model{osm_data};
+    std::string landmarks_file = "utest_landmarks.bin";
+
+    void TearDown() override {
+        std::remove(landmarks_file.c_str());
+    }
+};
+
+
+// Landmark bounds never exceed the road distance, and A* with them finds equally short routes
+// while expanding fewer nodes.
+TEST_F(LandmarkTableTest, TestBoundsAndRoutes) {
+    ASSERT_TRUE(model.BuildLandmarks(8));
+    ASSERT_NE(model.Landmarks(), nullptr);
+    EXPECT_EQ(model.Landmarks()->Nodes().size(), 8);
+
+    RoutePlanner planner{model};
+    long euclidean_expanded = 0, landmark_expanded = 0;
+    for (auto [start, goal] : RandomQueries(model, 300, 29)) {
+        auto forward = planner.Route(start, goal);
+        auto landmarks = planner.Route(start, goal, RoutePlanner::Search::Landmarks);
+        ASSERT_EQ(landmarks.path.empty(), forward.path.empty());
+        if (forward.path.empty())
+            continue;
+        const float distance = forward.distance / model.MetricScale();
+        EXPECT_LE(model.Landmarks()->LowerBound(start, goal), distance * (1.0f + 1e-4f) + 1e-6f);
+        EXPECT_NEAR(landmarks.distance, forward.distance, forward.distance * 1e-4f + 1e-3f);
+        EXPECT_EQ(landmarks.path.front(), start);
+        EXPECT_EQ(landmarks.path.back(), goal);
+        euclidean_expanded += forward.stats.expanded;
+        landmark_expanded += landmarks.stats.expanded;
+    }
+    EXPECT_LT(landmark_expanded, euclidean_expanded);
+}
+
+
+// Without landmarks, landmark queries are plain A*.
+TEST_F(LandmarkTableTest, TestFallback) {
+    EXPECT_FALSE(model.LoadLandmarks(landmarks_file));
+    RoutePlanner planner{model};
+    for (auto [start, goal] : RandomQueries(model, 20, 31)) {
+        auto forward = planner.Route(start, goal);
+        auto landmarks = planner.Route(start, goal, RoutePlanner::Search::Landmarks);
+        EXPECT_EQ(landmarks.path, forward.path);
+        EXPECT_EQ(landmarks.stats.expanded, forward.stats.expanded);
+    }
+}
+
+
+// Stored tables load into another model of the same map; truncated ones are rejected.
+TEST_F(LandmarkTableTest, TestSaveAndLoad) {
+    ASSERT_TRUE(model.BuildLandmarks(4, landmarks_file));
+    RouteModel other{osm_data};
+    ASSERT_TRUE(other.LoadLandmarks(landmarks_file));
+    EXPECT_EQ(other.Landmarks()->Nodes(), model.Landmarks()->Nodes());
+    for (auto [start, goal] : RandomQueries(model, 100, 37))
+        EXPECT_EQ(other.Landmarks()->LowerBound(start, goal), model.Landmarks()->LowerBound(start, goal));
+
+    auto data = *ReadFile(landmarks_file);
+    {
+        std::ofstream os{landmarks_file, std::ios::binary | std::ios::trunc};
+        os.write((const char *)data.data(), data.size() - 8);
+    }
+    RouteModel stale{osm_data};
+    EXPECT_FALSE(stale.LoadLandmarks(landmarks_file));
+    EXPECT_EQ(stale.Landmarks(), nullptr);
+}
@@ -0,0 +1,77 @@
+#include "gtest/gtest.h"
+#include <stdexcept>
+#include <vector>
+#include "../src/matrix_engine.h"
+#include "../src/route_model.h"
+#include "../src/route_planner.h"
+#include "test_data.h"
+
+//--------------------------------//
+//   Beginning MatrixEngine Tests.
+//--------------------------------//
+
+class MatrixEngineTest : public ::testing::Test {
+  protected:
+    std::vector<std::byte> osm_data = ReadOSMData("../map.osm");
+    RouteModel model{osm_data};
+
+    // Checks every entry against a RoutePlanner query.
+    void ExpectMatchesPlanner(const MatrixEngine::Matrix &matrix, const std::vector<int> &sources, const std::vector<int> &targets) {
+        ASSERT_EQ(matrix.rows, sources.size());
+        ASSERT_EQ(matrix.columns, targets.size());
+        RoutePlanner planner{model};
+        for (size_t row = 0; row < sources.size(); row++)
+            for (size_t column = 0; column < targets.size(); column++) {
+                auto route = planner.Route(sources[row], targets[column]);
+                if (route.path.empty())
+                    EXPECT_EQ(matrix.At(row, column), MatrixEngine::Matrix::kUnreachable);
+                else
+                    EXPECT_NEAR(matrix.At(row, column), route.distance, route.distance * 1e-4f + 1e-3f);
+            }
+    }
+};
+
+
+// One-to-many Dijkstra gives the planner's distances, including repeated and unreachable nodes.
+TEST_F(MatrixEngineTest, TestDijkstra) {
+    auto sources = RandomNodes(model, 20, 41), targets = RandomNodes(model, 30, 43);
+    targets.push_back(targets.front());
+    targets.push_back(sources.front());
+    MatrixEngine engine{model, 3};
+    auto matrix = engine.Compute(sources, targets);
+    ExpectMatchesPlanner(matrix, sources, targets);
+    EXPECT_EQ(matrix.At(0, targets.size() - 1), 0.0f);
+}
+
+
+// Bucket-based many-to-many on the hierarchy gives the same distances.
+TEST_F(MatrixEngineTest, TestHierarchy) {
+    auto sources = RandomNodes(model, 20, 47), targets = RandomNodes(model, 30, 53);
+    targets.push_back(sources.back());
+    MatrixEngine engine{model, 3};
+    EXPECT_THROW(engine.Compute(sources, targets, MatrixEngine::Method::Hierarchy), std::logic_error);
+    model.BuildHierarchy();
+    auto matrix = engine.Compute(sources, targets);
+    ExpectMatchesPlanner(matrix, sources, targets);
+    EXPECT_EQ(matrix.At(sources.size() - 1, targets.size() - 1), 0.0f);
+
+    auto dijkstra = engine.Compute(sources, targets, MatrixEngine::Method::Dijkstra);
+    for (size_t i = 0; i < matrix.meters.size(); i++) {
+        if (dijkstra.meters[i] == MatrixEngine::Matrix::kUnreachable)
+            EXPECT_EQ(matrix.meters[i], MatrixEngine::Matrix::kUnreachable);
+        else
+            EXPECT_NEAR(matrix.meters[i], dijkstra.meters[i], dijkstra.meters[i] * 1e-4f + 1e-3f);
+    }
+}
+
+
+// Empty lists give empty matrices and bad node indices throw.
+TEST_F(MatrixEngineTest, TestEdgeCases) {
+    MatrixEngine engine{model, 2};
+    auto empty = engine.Compute({}, RandomNodes(model, 5, 59));
+    EXPECT_EQ(empty.rows, 0);
+    EXPECT_EQ(empty.columns, 5);
+    EXPECT_TRUE(empty.meters.empty());
+    EXPECT_THROW(engine.Compute({-1}, {0}), std::logic_error);
+    EXPECT_THROW(engine.Compute({0}, {(int)model.SNodes().size()}), std::logic_error);
+}
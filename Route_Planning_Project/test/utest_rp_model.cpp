@@ -0,0 +1,397 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "../src/model.h"
+#include "../src/osm_id_index.h"
+#include "../src/xml_stream.h"
+#include "test_data.h"
+
+static void ExpectSameMultipolygons(const std::vector<Model::Multipolygon> &a, const std::vector<Model::Multipolygon> &b)
+{
+    ASSERT_EQ(a.size(), b.size());
+    for (size_t i = 0; i < a.size(); i++) {
+        EXPECT_EQ(a[i].outer, b[i].outer);
+        EXPECT_EQ(a[i].inner, b[i].inner);
+    }
+}
+
+template <typename MP>
+static std::vector<Model::Multipolygon> Slice(const std::vector<MP> &mps)
+{
+    return {mps.begin(), mps.end()};
+}
+
+// Compares two models field by field, coordinates bit for bit.
+static void ExpectSameModel(const Model &a, const Model &b)
+{
+    EXPECT_EQ(a.MetricScale(), b.MetricScale());
+    ASSERT_EQ(a.Nodes().size(), b.Nodes().size());
+    for (size_t i = 0; i < a.Nodes().size(); i++) {
+        EXPECT_EQ(a.Nodes()[i].x, b.Nodes()[i].x);
+        EXPECT_EQ(a.Nodes()[i].y, b.Nodes()[i].y);
+    }
+    ASSERT_EQ(a.Ways().size(), b.Ways().size());
+    for (size_t i = 0; i < a.Ways().size(); i++)
+        EXPECT_EQ(a.Ways()[i].nodes, b.Ways()[i].nodes);
+    ASSERT_EQ(a.Roads().size(), b.Roads().size());
+    for (size_t i = 0; i < a.Roads().size(); i++) {
+        EXPECT_EQ(a.Roads()[i].way, b.Roads()[i].way);
+        EXPECT_EQ(a.Roads()[i].type, b.Roads()[i].type);
+    }
+    ASSERT_EQ(a.Railways().size(), b.Railways().size());
+    for (size_t i = 0; i < a.Railways().size(); i++)
+        EXPECT_EQ(a.Railways()[i].way, b.Railways()[i].way);
+    ExpectSameMultipolygons(Slice(a.Buildings()), Slice(b.Buildings()));
+    ExpectSameMultipolygons(Slice(a.Leisures()), Slice(b.Leisures()));
+    ExpectSameMultipolygons(Slice(a.Waters()), Slice(b.Waters()));
+    ExpectSameMultipolygons(Slice(a.Landuses()), Slice(b.Landuses()));
+    ASSERT_EQ(a.Landuses().size(), b.Landuses().size());
+    for (size_t i = 0; i < a.Landuses().size(); i++)
+        EXPECT_EQ(a.Landuses()[i].type, b.Landuses()[i].type);
+}
+
+//--------------------------------//
+//   Beginning Model Tests.
+//--------------------------------//
+
+class ModelTest : public ::testing::Test {
+  protected:
+    std::vector<std::byte> osm_data = ReadOSMData("../map.osm");
+    std::string cache_file = "utest_model.cache";
+
+    void SetUp() override { std::remove(cache_file.c_str()); }
+    void TearDown() override { std::remove(cache_file.c_str()); }
+};
+
+
+// A snapshot written on the first load is used on the second and reproduces the parsed model.
+TEST_F(ModelTest, TestCacheRoundTrip) {
+    Model parsed{osm_data, {cache_file}};
+    EXPECT_FALSE(parsed.LoadedFromCache());
+
+    Model cached{osm_data, {cache_file}};
+    EXPECT_TRUE(cached.LoadedFromCache());
+    ExpectSameModel(parsed, cached);
+}
+
+
+// Loaders racing to write the same snapshot each write a file of their own, so the one left in
+// place is complete and no temporary file remains.
+TEST_F(ModelTest, TestCacheConcurrentWriters) {
+    std::vector<std::thread> writers;
+    for (int i = 0; i < 4; i++)
+        writers.emplace_back([&] { Model{osm_data, {cache_file}}; });
+    for (auto &writer : writers)
+        writer.join();
+
+    Model cached{osm_data, {cache_file}};
+    EXPECT_TRUE(cached.LoadedFromCache());
+    ExpectSameModel(Model{osm_data}, cached);
+    for (const auto &entry : std::filesystem::directory_iterator{"."})
+        EXPECT_NE(entry.path().filename().string().rfind(cache_file + ".", 0), 0) << entry.path();
+}
+
+
+// A snapshot made from different OSM data is ignored and replaced.
+TEST_F(ModelTest, TestCacheStaleSource) {
+    Model{osm_data, {cache_file}};
+
+    auto changed = osm_data;
+    changed.push_back(std::byte{'\n'});
+    Model reparsed{changed, {cache_file}};
+    EXPECT_FALSE(reparsed.LoadedFromCache());
+
+    Model cached{changed, {cache_file}};
+    EXPECT_TRUE(cached.LoadedFromCache());
+}
+
+
+// A truncated snapshot is rejected rather than partially loaded.
+TEST_F(ModelTest, TestCacheTruncated) {
+    Model parsed{osm_data, {cache_file}};
+    auto snapshot = ReadOSMData(cache_file);
+    snapshot.resize(snapshot.size() / 2);
+    std::ofstream{cache_file, std::ios::binary | std::ios::trunc}.write((const char*)snapshot.data(), snapshot.size());
+
+    Model reparsed{osm_data, {cache_file}};
+    EXPECT_FALSE(reparsed.LoadedFromCache());
+    ExpectSameModel(parsed, reparsed);
+}
+
+
+// The streaming loader builds the same model as the DOM based one.
+TEST_F(ModelTest, TestStreamLoader) {
+    Model dom{osm_data};
+    Model stream{std::string{"../map.osm"}};
+    ExpectSameModel(dom, stream);
+}
+
+
+// The parallel loader builds the same model as the serial ones, whatever the number of slices.
+TEST_F(ModelTest, TestParallelLoader) {
+    Model serial{osm_data};
+    for (unsigned threads : {2u, 3u, 8u, 1000u}) {
+        ModelOptions options;
+        options.threads = threads;
+        ExpectSameModel(serial, Model{osm_data, options});
+    }
+    ModelOptions options;
+    options.threads = 4;
+    ExpectSameModel(serial, Model{std::string{"../map.osm"}, options});
+}
+
+
+// Collects elements as "name attr=value ..." strings, end tags as "/name".
+class XmlRecorder : public XmlStreamParser::Handler {
+  public:
+    std::vector<std::string> events;
+    void StartElement(std::string_view name, const std::vector<XmlStreamParser::Attribute> &attributes) override {
+        std::string event{name};
+        for (auto &attribute : attributes)
+            event += " " + std::string{attribute.name} + "=" + std::string{attribute.value};
+        events.push_back(event);
+    }
+    void EndElement(std::string_view name) override { events.push_back("/" + std::string{name}); }
+};
+
+
+// Tags split across chunk boundaries are reported exactly as when parsed in one piece.
+TEST_F(ModelTest, TestXmlStreamChunks) {
+    const std::string xml = "<?xml version=\"1.0\"?>\n<!-- <node id=\"0\"/> -->\n<osm>"
+                            "<way id='7' note=\"a > b &amp; &#x41;&#66;\"><nd ref=\"1\"/><tag k=\"name\"\n v=\"x&lt;y\"/></way >"
+                            "<![CDATA[<node/>]]></osm>";
+    const std::vector<std::string> expected{
+        "osm", "way id=7 note=a > b & AB", "nd ref=1", "/nd", "tag k=name v=x<y", "/tag", "/way", "/osm"};
+    for (size_t chunk = 1; chunk <= xml.size(); chunk++) {
+        XmlRecorder recorder;
+        XmlStreamParser parser{recorder};
+        for (size_t i = 0; i < xml.size(); i += chunk)
+            parser.Feed(xml.data() + i, std::min(chunk, xml.size() - i));
+        parser.Finish();
+        EXPECT_EQ(recorder.events, expected) << "chunk size " << chunk;
+    }
+}
+
+
+// Truncated input is reported instead of silently producing a partial model.
+TEST_F(ModelTest, TestXmlStreamTruncated) {
+    XmlRecorder recorder;
+    XmlStreamParser parser{recorder};
+    const std::string xml = "<osm><node id=\"1";
+    parser.Feed(xml.data(), xml.size());
+    EXPECT_THROW(parser.Finish(), std::logic_error);
+}
+
+
+// Ids resolve the same whether they arrive sorted or not; repeated ids keep the latest index.
+TEST_F(ModelTest, TestOsmIdIndex) {
+    OsmIdIndex index;
+    for (int i = 0; i < 100; i++)
+        index.Insert(1000 + 3 * i, i);
+    EXPECT_TRUE(index.Sorted());
+    EXPECT_EQ(index.Find(1000), 0);
+    EXPECT_EQ(index.Find(1297), 99);
+    EXPECT_EQ(index.Find(1001), -1);
+
+    index.Insert(1003, 500);
+    index.Insert(-7, 501);
+    EXPECT_FALSE(index.Sorted());
+    EXPECT_EQ(index.Size(), 101);
+    EXPECT_EQ(index.Find(1003), 500);
+    EXPECT_EQ(index.Find(-7), 501);
+    for (int i = 2; i < 100; i++)
+        EXPECT_EQ(index.Find(1000 + 3 * i), i);
+    EXPECT_EQ(index.Find(1001), -1);
+
+    std::int64_t id;
+    EXPECT_TRUE(OsmIdIndex::Parse("9223372036854775807", id));
+    EXPECT_EQ(id, 9223372036854775807);
+    EXPECT_FALSE(OsmIdIndex::Parse("12a", id));
+    EXPECT_FALSE(OsmIdIndex::Parse("", id));
+}
+
+
+// Hilbert renumbering permutes the nodes without moving them: every way visits the same points,
+// neighboring nodes end up closer in memory, and caches keep the order they were built with.
+TEST_F(ModelTest, TestReorderNodes) {
+    ModelOptions options;
+    options.reorder_nodes = true;
+    Model file_order{osm_data};
+    Model reordered{osm_data, options};
+
+    ASSERT_EQ(reordered.Nodes().size(), file_order.Nodes().size());
+    ASSERT_EQ(reordered.Ways().size(), file_order.Ways().size());
+    std::int64_t file_gaps = 0, reordered_gaps = 0;
+    for (size_t i = 0; i < file_order.Ways().size(); i++) {
+        const auto &a = file_order.Ways()[i].nodes, &b = reordered.Ways()[i].nodes;
+        ASSERT_EQ(a.size(), b.size());
+        for (size_t j = 0; j < a.size(); j++) {
+            EXPECT_EQ(file_order.Nodes()[a[j]].x, reordered.Nodes()[b[j]].x);
+            EXPECT_EQ(file_order.Nodes()[a[j]].y, reordered.Nodes()[b[j]].y);
+            if (j > 0) {
+                file_gaps += std::abs(a[j] - a[j - 1]);
+                reordered_gaps += std::abs(b[j] - b[j - 1]);
+            }
+        }
+    }
+    EXPECT_LT(reordered_gaps, file_gaps);
+
+    Model{osm_data, {cache_file}};
+    options.cache_path = cache_file;
+    Model from_file_order_cache{osm_data, options};
+    EXPECT_FALSE(from_file_order_cache.LoadedFromCache());
+    Model cached{osm_data, options};
+    EXPECT_TRUE(cached.LoadedFromCache());
+    ExpectSameModel(reordered, cached);
+}
+
+
+// OSM data with one relation per entry of rings, each ring cut into the given number of
+// three-node fragments that are listed shuffled and randomly reversed. A ring with a missing
+// fragment loses its last one. Nodes of ring r get consecutive indices from r * 2 * fragments.
+static std::vector<std::byte> FragmentedRings(const std::vector<std::string> &tags, int fragments, bool missing_fragment,
+                                              std::mt19937 &rng)
+{
+    std::ostringstream xml;
+    xml << "<osm><bounds minlat=\"0\" minlon=\"0\" maxlat=\"1\" maxlon=\"1\"/>";
+    const int ring_nodes = 2 * fragments;
+    for (int r = 0; r < (int)tags.size(); r++)
+        for (int i = 0; i < ring_nodes; i++) {
+            const double angle = 6.283185307179586 * i / ring_nodes, radius = 0.1 + 0.05 * r;
+            xml << "<node id=\"" << r * ring_nodes + i + 1 << "\" lat=\"" << 0.5 + radius * std::sin(angle)
+                << "\" lon=\"" << 0.5 + radius * std::cos(angle) << "\"/>";
+        }
+    std::vector<std::vector<int>> members(tags.size());
+    for (int r = 0; r < (int)tags.size(); r++)
+        for (int i = 0; i < fragments - (missing_fragment && r == 0); i++) {
+            std::vector<int> ids{2 * i, 2 * i + 1, (2 * i + 2) % ring_nodes};
+            if (rng() % 2)
+                std::reverse(ids.begin(), ids.end());
+            const int way_id = r * fragments + i + 1;
+            xml << "<way id=\"" << way_id << "\">";
+            for (int id : ids)
+                xml << "<nd ref=\"" << r * ring_nodes + id + 1 << "\"/>";
+            xml << "</way>";
+            members[r].push_back(way_id);
+        }
+    for (int r = 0; r < (int)tags.size(); r++) {
+        std::shuffle(members[r].begin(), members[r].end(), rng);
+        xml << "<relation id=\"" << r + 1 << "\">";
+        for (int way_id : members[r])
+            xml << "<member type=\"way\" ref=\"" << way_id << "\" role=\"outer\"/>";
+        xml << "<tag k=\"type\" v=\"multipolygon\"/>" << tags[r] << "</relation>";
+    }
+    xml << "</osm>";
+    const auto text = xml.str();
+    return {(const std::byte *)text.data(), (const std::byte *)text.data() + text.size()};
+}
+
+// Thousands of shuffled fragments are stitched back into their rings, going around each ring
+// once; a ring with a fragment missing is dropped rather than searched exhaustively.
+TEST_F(ModelTest, TestStitchRings) {
+    std::mt19937 rng{19};
+    const int fragments = 5000;
+    const std::vector<std::string> tags{"<tag k=\"natural\" v=\"water\"/>", "<tag k=\"landuse\" v=\"forest\"/>"};
+    Model model{FragmentedRings(tags, fragments, false, rng)};
+
+    const int ring_nodes = 2 * fragments;
+    ASSERT_EQ(model.Waters().size(), 1);
+    ASSERT_EQ(model.Landuses().size(), 1);
+    for (const auto *mp : {(const Model::Multipolygon *)&model.Waters()[0], (const Model::Multipolygon *)&model.Landuses()[0]}) {
+        ASSERT_EQ(mp->outer.size(), 1);
+        const auto &nodes = model.Ways()[mp->outer[0]].nodes;
+        ASSERT_GT(nodes.size(), 1);
+        EXPECT_EQ(nodes.front(), nodes.back());
+        const int ring_start = nodes.front() / ring_nodes * ring_nodes;
+        std::set<int> distinct;
+        int direction = 0;
+        for (size_t i = 1; i < nodes.size(); i++) {
+            const int step = ((nodes[i] - nodes[i - 1]) % ring_nodes + ring_nodes) % ring_nodes;
+            if (step == 0)
+                continue;
+            ASSERT_TRUE(step == 1 || step == ring_nodes - 1);
+            if (direction == 0)
+                direction = step;
+            EXPECT_EQ(step, direction);
+            EXPECT_EQ(nodes[i] / ring_nodes * ring_nodes, ring_start);
+            distinct.insert(nodes[i]);
+        }
+        EXPECT_EQ(distinct.size(), ring_nodes);
+    }
+
+    Model broken{FragmentedRings(tags, fragments, true, rng)};
+    ASSERT_EQ(broken.Waters().size(), 1);
+    EXPECT_TRUE(broken.Waters()[0].outer.empty());
+    ASSERT_EQ(broken.Landuses().size(), 1);
+    EXPECT_EQ(broken.Landuses()[0].outer.size(), 1);
+}
+
+
+// Projecting with a tolerance moves no node further than that from its exact position, on the
+// sample map and across a continent-sized range of latitudes.
+TEST_F(ModelTest, TestProjectionTolerance) {
+    std::ostringstream xml;
+    xml << "<osm><bounds minlat=\"-80\" minlon=\"-20\" maxlat=\"80\" maxlon=\"20\"/>";
+    std::mt19937 rng{20};
+    std::uniform_real_distribution<double> lat{-80.0, 80.0}, lon{-20.0, 20.0};
+    for (int i = 0; i < 100000; i++)
+        xml << "<node id=\"" << i + 1 << "\" lat=\"" << lat(rng) << "\" lon=\"" << lon(rng) << "\"/>";
+    xml << "</osm>";
+    const auto text = xml.str();
+    std::vector<std::byte> wide_data((const std::byte *)text.data(), (const std::byte *)text.data() + text.size());
+
+    for (auto *data : {&osm_data, &wide_data})
+        for (double tolerance : {1e-2, 1e-3, 1e-6}) {
+            ModelOptions options;
+            options.projection_tolerance = tolerance;
+            Model exact{*data}, series{*data, options};
+            ASSERT_EQ(series.MetricScale(), exact.MetricScale());
+            ASSERT_EQ(series.Nodes().size(), exact.Nodes().size());
+            double deviation = 0.0;
+            for (size_t i = 0; i < exact.Nodes().size(); i++) {
+                EXPECT_EQ(series.Nodes()[i].x, exact.Nodes()[i].x);
+                deviation = std::max(deviation, std::abs(series.Nodes()[i].y - exact.Nodes()[i].y) * exact.MetricScale());
+            }
+            EXPECT_LE(deviation, tolerance);
+        }
+}
+
+
+// The extent spans the map's bounds, shorter side first scaled to 1, so its far corner maps back
+// to the bounds' north-east corner.
+TEST_F(ModelTest, TestExtent) {
+    Model model{osm_data};
+    const auto extent = model.Extent();
+    EXPECT_DOUBLE_EQ(std::min(extent.x, extent.y), 1.0);
+    const auto corner = model.ToLocation(extent.x, extent.y);
+    EXPECT_NEAR(corner.lat, 30.2795700, 1e-9);
+    EXPECT_NEAR(corner.lon, -97.7319500, 1e-9);
+}
+
+
+// Coordinates are parsed however many digits they are written with, by the DOM parser and the
+// streaming one alike, rather than put at 0.
+TEST_F(ModelTest, TestLongCoordinates) {
+    const std::string digits(80, '1');
+    const std::string text = "<osm><bounds minlat=\"10.0\" minlon=\"20.0\" maxlat=\"11.0\" maxlon=\"21.0\"/>"
+                             "<node id=\"1\" lat=\"10.5" + digits + "\" lon=\"20.5" + digits + "\"/>"
+                             "<node id=\"2\" lat=\"10.51111111111111\" lon=\"20.51111111111111\"/></osm>";
+    std::vector<std::byte> data((const std::byte *)text.data(), (const std::byte *)text.data() + text.size());
+    const std::string file = "utest_long_coordinates.osm";
+    std::ofstream{file} << text;
+
+    for (const auto &model : {Model{data}, Model{file}}) {
+        ASSERT_EQ(model.Nodes().size(), 2);
+        EXPECT_NEAR(model.Nodes()[0].x, model.Nodes()[1].x, 1e-9);
+        EXPECT_NEAR(model.Nodes()[0].y, model.Nodes()[1].y, 1e-9);
+    }
+    std::remove(file.c_str());
+}
@@ -0,0 +1,101 @@
+#include "gtest/gtest.h"
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../src/route_batch.h"
+#include "../src/route_engine.h"
+#include "../src/route_model.h"
+#include "../src/route_planner.h"
+#include "test_data.h"
+
+static std::vector<std::string> Lines(const std::string &text)
+{
+    std::vector<std::string> lines;
+    std::istringstream is{text};
+    for (std::string line; std::getline(is, line);)
+        lines.push_back(line);
+    return lines;
+}
+
+//--------------------------------//
+//   Beginning RouteBatch Tests.
+//--------------------------------//
+
+class RouteBatchTest : public ::testing::Test {
+  protected:
+    std::vector<std::byte> osm_data = ReadOSMData("../map.osm");
+    RouteModel model{osm_data};
+    RoutePlanner planner{model};
+
+    std::string Expected(const std::string &id, float start_x, float start_y, float end_x, float end_y) {
+        auto route = planner.Route(start_x, start_y, end_x, end_y);
+        char row[128];
+        std::snprintf(row, sizeof(row), "%s,%.1f,%.1f,%zu", id.c_str(), route.distance, route.seconds, route.path.size());
+        return row;
+    }
+};
+
+
+// Rows keep their ids or get their numbers, the header is skipped and rows that are not queries
+// are reported without stopping the batch.
+TEST_F(RouteBatchTest, TestRows) {
+    std::istringstream in{"start_x,start_y,end_x,end_y\r\n10,10,90,90\n\nq7,20,80, 70,30\nbad,row\n1,2,3,x"};
+    std::ostringstream out;
+    RouteEngine engine{model, 2};
+    const auto summary = RouteBatch(model, engine, in, out);
+    EXPECT_EQ(summary.rows, 4);
+    EXPECT_EQ(summary.malformed, 2);
+    EXPECT_EQ(summary.unroutable, 0);
+    EXPECT_EQ(Lines(out.str()), (std::vector<std::string>{"id,distance_m,seconds,nodes", Expected("1", 10, 10, 90, 90),
+                                                          Expected("q7", 20, 80, 70, 30), "3,,,0", "4,,,0"}));
+}
+
+
+// Results do not depend on the number of workers or the chunk size.
+TEST_F(RouteBatchTest, TestChunks) {
+    std::mt19937 rng{23};
+    std::uniform_real_distribution<float> coordinate{0.f, 100.f};
+    std::string queries;
+    for (int i = 0; i < 500; i++)
+        queries += std::to_string(coordinate(rng)) + "," + std::to_string(coordinate(rng)) + "," +
+                   std::to_string(coordinate(rng)) + "," + std::to_string(coordinate(rng)) + "\n";
+
+    BatchOptions options;
+    options.polylines = true;
+    std::istringstream serial_in{queries};
+    std::ostringstream serial_out;
+    RouteEngine serial{model, 1};
+    RouteBatch(model, serial, serial_in, serial_out, options);
+
+    options.chunk_rows = 37;
+    std::istringstream parallel_in{queries};
+    std::ostringstream parallel_out;
+    RouteEngine parallel{model, 4};
+    const auto summary = RouteBatch(model, parallel, parallel_in, parallel_out, options);
+    EXPECT_EQ(summary.rows, 500);
+    EXPECT_EQ(parallel_out.str(), serial_out.str());
+    EXPECT_EQ(Lines(serial_out.str()).size(), 501);
+}
+
+
+// Polylines follow Google's reference encoding, over the latitudes and longitudes the model's
+// points map back to.
+TEST_F(RouteBatchTest, TestPolyline) {
+    std::string encoded;
+    EncodePolyline({{38.5, -120.2}, {40.7, -120.95}, {43.252, -126.453}}, encoded);
+    EXPECT_EQ(encoded, "_p~iF~ps|U_ulLnnqC_mqNvxq`@");
+
+    // map.osm spans latitudes 30.27059 to 30.27957 and longitudes -97.74541 to -97.73195.
+    const auto corner = model.ToLocation(0, 0);
+    EXPECT_NEAR(corner.lat, 30.27059, 1e-9);
+    EXPECT_NEAR(corner.lon, -97.74541, 1e-9);
+    // Model coordinates are scaled by the shorter side of the map: 1 is that side's far bound and
+    // lies within the bounds of the other.
+    const auto far_corner = model.ToLocation(1, 1);
+    EXPECT_TRUE(std::abs(far_corner.lat - 30.27957) < 1e-9 || std::abs(far_corner.lon - -97.73195) < 1e-9);
+    EXPECT_LE(far_corner.lat, 30.27957 + 1e-9);
+    EXPECT_LE(far_corner.lon, -97.73195 + 1e-9);
+}
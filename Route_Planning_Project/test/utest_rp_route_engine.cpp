@@ -0,0 +1,60 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include "../src/route_engine.h"
+#include "../src/route_model.h"
+#include "../src/thread_pool.h"
+#include "test_data.h"
+
+// RandomQueries between nodes on roads, as engine queries.
+static std::vector<RouteEngine::Query> RoadQueries(const RouteModel &model, int count, unsigned seed)
+{
+    std::vector<RouteEngine::Query> queries;
+    for (auto [start, goal] : RandomQueries(model, count, seed, true))
+        queries.push_back({start, goal});
+    return queries;
+}
+
+//--------------------------------//
+//   Beginning RouteEngine Tests.
+//--------------------------------//
+
+class RouteEngineTest : public ::testing::Test {
+  protected:
+    std::vector<std::byte> osm_data = ReadOSMData("../map.osm");
+    RouteModel model{osm_data};
+};
+
+
+// Concurrent batches give the same answers as one planner running the queries in order.
+TEST_F(RouteEngineTest, TestBatchMatchesSequential) {
+    auto queries = RoadQueries(model, 200, 7);
+    RouteEngine engine{model, 4};
+    EXPECT_EQ(engine.Threads(), 4);
+    auto results = engine.Route(queries);
+
+    RoutePlanner planner{model};
+    ASSERT_EQ(results.size(), queries.size());
+    for (std::size_t i = 0; i < queries.size(); i++) {
+        auto expected = planner.Route(queries[i].start, queries[i].goal);
+        EXPECT_EQ(results[i].path, expected.path);
+        EXPECT_FLOAT_EQ(results[i].distance, expected.distance);
+        EXPECT_EQ(results[i].stats.expanded, expected.stats.expanded);
+        EXPECT_EQ(results[i].stats.pushed, expected.stats.pushed);
+    }
+}
+
+
+// Exceptions thrown by parallel work reach the caller, and the pool stays usable.
+TEST_F(RouteEngineTest, TestThreadPoolErrors) {
+    ThreadPool pool{3};
+    EXPECT_THROW(pool.ParallelFor(100, [](size_t index, unsigned) {
+        if (index == 42)
+            throw std::runtime_error("failed");
+    }), std::runtime_error);
+
+    std::vector<int> done(100, 0);
+    pool.ParallelFor(done.size(), [&](size_t index, unsigned) { done[index]++; });
+    EXPECT_EQ(std::count(done.begin(), done.end(), 1), 100);
+}
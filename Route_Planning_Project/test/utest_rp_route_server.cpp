@@ -0,0 +1,196 @@
+#include "gtest/gtest.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "../src/route_model.h"
+#include "../src/route_planner.h"
+#include "../src/route_server.h"
+#include "test_data.h"
+
+// Sends the requests on a new connection, closes its sending side and returns the answer lines
+// received until the server closes it.
+static std::vector<std::string> Exchange(const sockaddr *address, socklen_t length, const std::string &requests)
+{
+    const int fd = socket(address->sa_family, SOCK_STREAM, 0);
+    EXPECT_EQ(connect(fd, address, length), 0);
+    for (std::size_t sent = 0; sent < requests.size();) {
+        const auto count = send(fd, requests.data() + sent, requests.size() - sent, MSG_NOSIGNAL);
+        if (count <= 0)
+            break;
+        sent += count;
+    }
+    shutdown(fd, SHUT_WR);
+    std::string received;
+    char buffer[4096];
+    for (ssize_t count; (count = recv(fd, buffer, sizeof(buffer), 0)) > 0;)
+        received.append(buffer, count);
+    close(fd);
+    std::vector<std::string> lines;
+    for (std::size_t begin = 0, end; (end = received.find('\n', begin)) != std::string::npos; begin = end + 1)
+        lines.push_back(received.substr(begin, end - begin));
+    return lines;
+}
+
+//--------------------------------//
+//   Beginning RouteServer Tests.
+//--------------------------------//
+
+class RouteServerTest : public ::testing::Test {
+  protected:
+    std::vector<std::byte> osm_data = ReadOSMData("../map.osm");
+    RouteModel model{osm_data};
+    RoutePlanner planner{model};
+
+    // Random requests, with the answers a planner gives to them one by one.
+    void RandomRequests(int count, unsigned seed, std::string &requests, std::vector<std::string> &answers) {
+        std::mt19937 rng{seed};
+        std::uniform_real_distribution<float> coordinate{0.f, 100.f};
+        const char *options[] = {"", " car", " foot bidirectional", " forward"};
+        for (int i = 0; i < count; i++) {
+            std::string request = std::to_string(coordinate(rng)) + " " + std::to_string(coordinate(rng)) + " " +
+                                  std::to_string(coordinate(rng)) + " " + std::to_string(coordinate(rng)) + options[i % 4];
+            requests += request + "\n";
+            answers.push_back(RouteServer::Answer(model, planner, request));
+        }
+    }
+};
+
+
+// Requests are parsed with their options, and malformed ones get an error instead of a route.
+TEST_F(RouteServerTest, TestAnswer) {
+    const auto answer = RouteServer::Answer(model, planner, "10 10 90 90");
+    auto route = planner.Route(10.f, 10.f, 90.f, 90.f);
+    ASSERT_FALSE(route.path.empty());
+    EXPECT_EQ(answer.rfind("ok ", 0), 0);
+    EXPECT_NE(answer.find(" " + std::to_string(route.path.size()) + " "), std::string::npos);
+    EXPECT_EQ(RouteServer::Answer(model, planner, "  10\t10 90 90 car hierarchy").rfind("ok ", 0), 0);
+
+    for (const char *bad : {"", "10 10 90", "10 10 90 x", "10 10 90 90 fly", "10 10 90 90 car bike foot", "nan 1 2 3"})
+        EXPECT_EQ(RouteServer::Answer(model, planner, bad).rfind("error ", 0), 0) << bad;
+}
+
+
+// Pipelined requests on one TCP connection come back in order, with the planner's answers.
+TEST_F(RouteServerTest, TestPipelinedRequests) {
+    RouteServer server{model, 4};
+    ASSERT_TRUE(server.Listen("127.0.0.1:0"));
+    ASSERT_GT(server.Port(), 0);
+    std::thread loop{[&] { server.Run(); }};
+
+    std::string requests;
+    std::vector<std::string> answers;
+    RandomRequests(300, 22, requests, answers);
+    requests += "10 10 nowhere 90\r\n";
+    answers.push_back(RouteServer::Answer(model, planner, "10 10 nowhere 90"));
+    requests += "20 20 80 80"; // No line break after the last request.
+    answers.push_back(RouteServer::Answer(model, planner, "20 20 80 80"));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(server.Port());
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    EXPECT_EQ(Exchange((const sockaddr *)&address, sizeof(address), requests), answers);
+
+    server.Stop();
+    loop.join();
+}
+
+
+// Clients on a Unix domain socket are served concurrently, each getting its own answers.
+TEST_F(RouteServerTest, TestConcurrentClients) {
+    const std::string path = "utest_route_server.sock";
+    RouteServer server{model, 2};
+    ASSERT_TRUE(server.Listen("unix:" + path));
+    EXPECT_EQ(server.Port(), 0);
+    std::thread loop{[&] { server.Run(); }};
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    path.copy(address.sun_path, path.size());
+    std::vector<std::string> requests(4);
+    std::vector<std::vector<std::string>> answers(4), received(4);
+    for (int client = 0; client < 4; client++)
+        RandomRequests(100, client, requests[client], answers[client]);
+    std::vector<std::thread> clients;
+    for (int client = 0; client < 4; client++)
+        clients.emplace_back([&, client] {
+            received[client] = Exchange((const sockaddr *)&address, sizeof(address), requests[client]);
+        });
+    for (auto &client : clients)
+        client.join();
+    EXPECT_EQ(received, answers);
+
+    server.Stop();
+    loop.join();
+    EXPECT_FALSE(server.Listen("unix:" + std::string(200, 'x')));
+}
+
+
+// A client pipelining several times kMaxPending requests is throttled rather than refused: every
+// request is answered, in order.
+TEST_F(RouteServerTest, TestMorePendingThanLimit) {
+    RouteServer server{model, 2};
+    ASSERT_TRUE(server.Listen("127.0.0.1:0"));
+    std::thread loop{[&] { server.Run(); }};
+
+    // Malformed requests are cheap to answer and each gets an answer of its own.
+    std::string requests;
+    std::vector<std::string> answers;
+    for (std::uint64_t i = 0; i < 3 * RouteServer::kMaxPending; i++) {
+        const auto request = "10 10 90 x" + std::to_string(i);
+        requests += request + "\n";
+        answers.push_back(RouteServer::Answer(model, planner, request));
+    }
+    RandomRequests(20, 25, requests, answers);
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(server.Port());
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    EXPECT_EQ(Exchange((const sockaddr *)&address, sizeof(address), requests), answers);
+
+    server.Stop();
+    loop.join();
+}
+
+
+// A line longer than kMaxLine gets its connection closed soon after the limit is passed, without
+// the server reading the rest of it; other clients are still served.
+TEST_F(RouteServerTest, TestOverlongLine) {
+    RouteServer server{model, 2};
+    ASSERT_TRUE(server.Listen("127.0.0.1:0"));
+    std::thread loop{[&] { server.Run(); }};
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(server.Port());
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_EQ(connect(fd, (const sockaddr *)&address, sizeof(address)), 0);
+    const std::string chunk(64 * 1024, '1');
+    const std::size_t total = 256 * chunk.size();
+    std::size_t sent = 0;
+    while (sent < total) {
+        const auto count = send(fd, chunk.data(), chunk.size(), MSG_NOSIGNAL);
+        if (count <= 0)
+            break;
+        sent += count;
+    }
+    EXPECT_LT(sent, total);
+    char byte;
+    EXPECT_LE(recv(fd, &byte, 1, 0), 0);
+    close(fd);
+
+    const std::vector<std::string> answers{RouteServer::Answer(model, planner, "10 10 90 90")};
+    EXPECT_EQ(Exchange((const sockaddr *)&address, sizeof(address), "10 10 90 90\n"), answers);
+
+    server.Stop();
+    loop.join();
+}
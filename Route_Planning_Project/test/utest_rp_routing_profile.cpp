@@ -0,0 +1,128 @@
+#include "gtest/gtest.h"
+#include <random>
+#include <vector>
+#include "../src/route_model.h"
+#include "../src/route_planner.h"
+#include "../src/routing_profile.h"
+#include "test_data.h"
+
+//--------------------------------//
+//   Beginning RoutingProfile Tests.
+//--------------------------------//
+
+class RoutingProfileTest : public ::testing::Test {
+  protected:
+    std::vector<std::byte> osm_data = ReadOSMData("../map.osm");
+    RouteModel model{osm_data};
+    RoutePlanner route_planner{model};
+    std::mt19937 rng{5};
+
+    // Random node on a road the profile allows.
+    template <typename P>
+    int RandomNode() {
+        const auto &graph = model.RoadGraph();
+        std::uniform_int_distribution<int> pick{0, (int)model.SNodes().size() - 1};
+        while (true) {
+            const int node = pick(rng);
+            for (int edge = graph.offsets[node]; edge < graph.offsets[node + 1]; edge++)
+                if (P::Allows(graph.types[edge]))
+                    return node;
+        }
+    }
+
+    // Type of the road the profile allows between two consecutive route nodes, Invalid if none.
+    template <typename P>
+    RoadType SegmentType(int from, int to) const {
+        const auto &graph = model.RoadGraph();
+        for (int edge = graph.offsets[from]; edge < graph.offsets[from + 1]; edge++)
+            if (graph.targets[edge] == to && P::Allows(graph.types[edge]))
+                return graph.types[edge];
+        return Model::Road::Invalid;
+    }
+};
+
+
+// Every profile routes over roads it allows only, and times follow from its speeds.
+TEST_F(RoutingProfileTest, TestRoutesUseAllowedRoads) {
+    for (int i = 0; i < 50; i++) {
+        const int start = RandomNode<CarProfile>(), goal = RandomNode<CarProfile>();
+        auto car = route_planner.Route(start, goal, RoutePlanner::Search::Forward, Profile::Car);
+        for (size_t j = 1; j < car.path.size(); j++)
+            EXPECT_NE(SegmentType<CarProfile>(car.path[j - 1], car.path[j]), Model::Road::Invalid);
+        auto foot = route_planner.Route(RandomNode<FootProfile>(), RandomNode<FootProfile>(),
+                                        RoutePlanner::Search::Forward, Profile::Foot);
+        for (size_t j = 1; j < foot.path.size(); j++)
+            EXPECT_NE(SegmentType<FootProfile>(foot.path[j - 1], foot.path[j]), Model::Road::Invalid);
+        EXPECT_NEAR(foot.seconds, foot.distance / FootProfile::Speed(Model::Road::Residential), foot.seconds * 1e-4f + 1e-3f);
+    }
+}
+
+
+// The car profile trades distance for time: never slower than the shortest route on the same
+// roads, never shorter.
+TEST_F(RoutingProfileTest, TestFastestRoute) {
+    int faster = 0;
+    for (int i = 0; i < 100; i++) {
+        const int start = RandomNode<CarProfile>(), goal = RandomNode<CarProfile>();
+        auto shortest = route_planner.Route(start, goal);
+        auto fastest = route_planner.Route(start, goal, RoutePlanner::Search::Forward, Profile::Car);
+        ASSERT_EQ(fastest.path.empty(), shortest.path.empty());
+        EXPECT_LE(fastest.seconds, shortest.seconds * (1 + 1e-4f) + 1e-3f);
+        EXPECT_GE(fastest.distance, shortest.distance * (1 - 1e-4f) - 1e-3f);
+        faster += fastest.seconds < shortest.seconds * 0.99f;
+    }
+    EXPECT_GT(faster, 0);
+}
+
+
+// Pedestrians may take footways, which the default profile never uses.
+TEST_F(RoutingProfileTest, TestFootUsesFootways) {
+    int footway_segments = 0;
+    for (int i = 0; i < 100; i++) {
+        auto route = route_planner.Route(RandomNode<FootProfile>(), RandomNode<FootProfile>(),
+                                         RoutePlanner::Search::Forward, Profile::Foot);
+        for (size_t j = 1; j < route.path.size(); j++)
+            if (SegmentType<DistanceProfile>(route.path[j - 1], route.path[j]) == Model::Road::Invalid)
+                footway_segments++;
+    }
+    EXPECT_GT(footway_segments, 0);
+
+    // Points snap to the roads of the profile: a node only footways lead to is its own closest
+    // node on foot and not by car.
+    const auto &graph = model.RoadGraph();
+    int checked = 0;
+    for (int node = 0; node < (int)model.SNodes().size() && checked < 10; node++) {
+        if (graph.offsets[node] == graph.offsets[node + 1])
+            continue;
+        bool footway_only = true;
+        for (int edge = graph.offsets[node]; edge < graph.offsets[node + 1]; edge++)
+            footway_only = footway_only && graph.types[edge] == Model::Road::Footway;
+        if (!footway_only)
+            continue;
+        const auto &point = model.SNodes()[node];
+        EXPECT_EQ(model.FindClosestNode(point.x, point.y, Profile::Foot).distance(point), 0.0f);
+        EXPECT_GT(model.FindClosestNode(point.x, point.y, Profile::Car).distance(point), 0.0f);
+        checked++;
+    }
+    EXPECT_EQ(checked, 10);
+}
+
+
+// Bidirectional search and landmark bounds find routes as fast as the forward search for every
+// profile; the hierarchy falls back to forward search for time profiles.
+TEST_F(RoutingProfileTest, TestSearchesAgree) {
+    model.BuildLandmarks(8);
+    model.BuildHierarchy();
+    for (Profile profile : {Profile::Car, Profile::Bike, Profile::Foot}) {
+        for (int i = 0; i < 50; i++) {
+            const int start = RandomNode<FootProfile>(), goal = RandomNode<FootProfile>();
+            auto forward = route_planner.Route(start, goal, RoutePlanner::Search::Forward, profile);
+            for (auto search : {RoutePlanner::Search::Bidirectional, RoutePlanner::Search::Landmarks,
+                                RoutePlanner::Search::Hierarchy}) {
+                auto other = route_planner.Route(start, goal, search, profile);
+                ASSERT_EQ(other.path.empty(), forward.path.empty());
+                EXPECT_NEAR(other.seconds, forward.seconds, forward.seconds * 1e-4f + 1e-3f);
+            }
+        }
+    }
+}
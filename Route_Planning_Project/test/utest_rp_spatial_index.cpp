@@ -0,0 +1,105 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "../src/route_model.h"
+#include "../src/spatial_index.h"
+#include "test_data.h"
+
+//--------------------------------//
+//   Beginning SpatialIndex Tests.
+//--------------------------------//
+
+class SpatialIndexTest : public ::testing::Test {
+  protected:
+    std::vector<std::byte> osm_data = ReadOSMData("../map.osm");
+    RouteModel model{osm_data};
+
+    // Nodes of non-footway roads with their distance to (x, y), nearest first.
+    std::vector<std::pair<double, int>> BruteForce(double x, double y) const {
+        std::vector<std::pair<double, int>> found;
+        for (const Model::Road &road : model.Roads()) {
+            if (road.type == Model::Road::Type::Footway)
+                continue;
+            for (int node : model.Ways()[road.way].nodes) {
+                const double dx = model.Nodes()[node].x - x, dy = model.Nodes()[node].y - y;
+                found.push_back({dx * dx + dy * dy, node});
+            }
+        }
+        std::sort(found.begin(), found.end());
+        found.erase(std::unique(found.begin(), found.end()), found.end());
+        return found;
+    }
+
+    // Query points spread over and slightly beyond the map.
+    std::vector<std::pair<double, double>> RandomPoints(int count) const {
+        std::mt19937 rng{11};
+        std::uniform_real_distribution<double> coordinate{-0.2, 1.2};
+        std::vector<std::pair<double, double>> points;
+        for (int i = 0; i < count; i++)
+            points.push_back({coordinate(rng), coordinate(rng)});
+        return points;
+    }
+};
+
+
+// Nearest and FindClosestNode agree with a scan over every road node.
+TEST_F(SpatialIndexTest, TestNearest) {
+    for (auto [x, y] : RandomPoints(500)) {
+        auto expected = BruteForce(x, y).front();
+        EXPECT_EQ(model.RoadNodeIndex().Nearest(x, y), expected.second);
+        auto &closest = model.FindClosestNode(x, y);
+        const double dx = closest.x - float(x), dy = closest.y - float(y);
+        EXPECT_NEAR(dx * dx + dy * dy, BruteForce(float(x), float(y)).front().first, 1e-12);
+    }
+}
+
+
+// KNearest returns the k closest road nodes, nearest first.
+TEST_F(SpatialIndexTest, TestKNearest) {
+    for (auto [x, y] : RandomPoints(100)) {
+        auto expected = BruteForce(x, y);
+        for (size_t k : {1, 5, 32}) {
+            auto found = model.RoadNodeIndex().KNearest(x, y, k);
+            ASSERT_EQ(found.size(), k);
+            for (size_t i = 0; i < k; i++)
+                EXPECT_EQ(found[i], expected[i].second);
+        }
+    }
+    EXPECT_TRUE(model.RoadNodeIndex().KNearest(0.5, 0.5, 0).empty());
+    EXPECT_EQ(model.RoadNodeIndex().KNearest(0.5, 0.5, 1000000).size(), model.RoadNodeIndex().Size());
+}
+
+
+// Radius returns exactly the road nodes within the radius, nearest first.
+TEST_F(SpatialIndexTest, TestRadius) {
+    for (auto [x, y] : RandomPoints(100)) {
+        auto expected = BruteForce(x, y);
+        for (double radius : {0.0, 0.01, 0.05, 0.3}) {
+            std::vector<int> within;
+            for (auto [distance2, node] : expected)
+                if (distance2 <= radius * radius)
+                    within.push_back(node);
+            EXPECT_EQ(model.RoadNodeIndex().Radius(x, y, radius), within);
+        }
+    }
+}
+
+
+// Degenerate inputs: no nodes, one node, all nodes on a line.
+TEST(SpatialIndexEdgeTest, TestDegenerate) {
+    std::vector<Model::Node> nodes{{0.0, 0.0}, {1.0, 0.0}, {2.0, 0.0}, {3.0, 0.0}};
+    SpatialIndex empty{nodes, {}};
+    EXPECT_EQ(empty.Nearest(0.0, 0.0), -1);
+    EXPECT_TRUE(empty.KNearest(0.0, 0.0, 3).empty());
+    EXPECT_TRUE(empty.Radius(0.0, 0.0, 10.0).empty());
+
+    SpatialIndex single{nodes, {2, 2}};
+    EXPECT_EQ(single.Size(), 1);
+    EXPECT_EQ(single.Nearest(-5.0, 7.0), 2);
+
+    SpatialIndex line{nodes, {0, 1, 2, 3}};
+    EXPECT_EQ(line.Nearest(2.4, 1.0), 2);
+    EXPECT_EQ(line.KNearest(10.0, 0.0, 2), (std::vector<int>{3, 2}));
+    EXPECT_EQ(line.Radius(1.5, 0.0, 0.6), (std::vector<int>{1, 2}));
+}